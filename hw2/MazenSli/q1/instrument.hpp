@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+/*
+ * Counters and timers for the line library and the q2 bindings, compiled in
+ * with -DLINE_INSTRUMENT (make INSTRUMENT=1 here or in ../q2).  They count
+ * Line copies, moves, copy-on-write detaches and allocations (line.*) and
+ * time the geometry kernels, the simplifiers and the q2 angle functions.
+ * Without the macro INSTRUMENT_COUNT and INSTRUMENT_TIME expand to nothing
+ * and snapshot() is empty, so a release Line copy costs no more than before.
+ *
+ * A Line is copied on whichever thread uses it, so each thread bumps its own
+ * copy of a counter with a plain relaxed store; snapshot() adds the copies
+ * up, those of exited threads included, and reset() only records a baseline
+ * that later snapshots subtract.  A timer is two counters, <name>.calls and
+ * <name>.ns, of steady_clock nanoseconds.
+ */
+namespace instrument
+{
+
+#ifdef LINE_INSTRUMENT
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+size_t const max_counters = 128;
+
+/* The copies of every counter that belong to one thread */
+struct ThreadCounters
+{
+    ThreadCounters();
+    ThreadCounters(ThreadCounters const &) = delete;
+    ThreadCounters &operator=(ThreadCounters const &) = delete;
+    ~ThreadCounters();
+
+    std::atomic<uint64_t> value[max_counters] = {};
+}; /* end struct ThreadCounters */
+
+inline ThreadCounters &thread_counters()
+{
+    thread_local ThreadCounters ret;
+    return ret;
+}
+
+// The slot of the named counter, added on first use (throws
+// std::length_error past max_counters).  Equal names share a slot.
+size_t counter_slot(std::string const &name);
+
+class Counter
+{
+public:
+    explicit Counter(std::string const &name) : m_slot(counter_slot(name)) {}
+
+    void add(uint64_t n = 1) const
+    {
+        std::atomic<uint64_t> &value = thread_counters().value[m_slot];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+private:
+    size_t m_slot;
+}; /* end class Counter */
+
+class Timer
+{
+public:
+    explicit Timer(std::string const &name) : m_calls(name + ".calls"), m_ns(name + ".ns") {}
+
+    /* Times its own lifetime */
+    class Scope
+    {
+    public:
+        explicit Scope(Timer const &timer) : m_timer(timer), m_start(std::chrono::steady_clock::now()) {}
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+        ~Scope()
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+            m_timer.m_calls.add();
+            m_timer.m_ns.add(ns.count());
+        }
+
+    private:
+        Timer const &m_timer;
+        std::chrono::steady_clock::time_point m_start;
+    }; /* end class Scope */
+
+private:
+    Counter m_calls;
+    Counter m_ns;
+}; /* end class Timer */
+
+// Counter name to value since the last reset(), over all threads.
+std::map<std::string, uint64_t> snapshot();
+void reset();
+
+} /* end namespace instrument */
+
+#define INSTRUMENT_CAT_(a, b) a##b
+#define INSTRUMENT_CAT(a, b) INSTRUMENT_CAT_(a, b)
+
+#ifdef LINE_INSTRUMENT
+// Add n to the named counter.
+#define INSTRUMENT_COUNT(name, n)                                                                                      \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static ::instrument::Counter const instrument_counter(name);                                                   \
+        instrument_counter.add(n);                                                                                     \
+    } while (0)
+// Time the rest of the enclosing block.
+#define INSTRUMENT_TIME(name)                                                                                          \
+    static ::instrument::Timer const INSTRUMENT_CAT(instrument_timer_, __LINE__)(name);                                \
+    ::instrument::Timer::Scope INSTRUMENT_CAT(instrument_scope_, __LINE__)(INSTRUMENT_CAT(instrument_timer_, __LINE__))
+#else
+#define INSTRUMENT_COUNT(name, n) ((void)0)
+#define INSTRUMENT_TIME(name) ((void)0)
+#endif
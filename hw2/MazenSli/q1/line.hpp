@@ -5,36 +5,430 @@
 #include <string>
 #include <iterator>  // for back_inserter
 #include <algorithm> // for copy() and assign()
+#include <stdexcept> // for out_of_range
+#include <cstddef>   // for ptrdiff_t
+#include <utility>   // for declval() and swap()
+#include <memory>    // for allocator and shared_ptr
+#include <atomic>    // for atomic_thread_fence()
+
+#include "instrument.hpp"
 
 using namespace std;
 
-class Line
+/*
+ * Non-owning view over coordinates that are either contiguous (stride 1) or
+ * interleaved with the other axis (stride 2).
+ */
+template <typename T>
+class StridedSpan
 {
 public:
+    StridedSpan(T *data, size_t size, ptrdiff_t stride)
+        : m_data(data), m_size(size), m_stride(stride) {}
+
+    T *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    ptrdiff_t stride() const { return m_stride; }
+    bool empty() const { return 0 == m_size; }
+    bool contiguous() const { return 1 == m_stride; }
+    T &operator[](size_t it) const { return m_data[it * m_stride]; }
+
+private:
+    T *m_data;
+    size_t m_size;
+    ptrdiff_t m_stride;
+}; /* end class StridedSpan */
+
+/*
+ * Range-checking policies.  The check is a compare against the point count
+ * and inlines into the accessor; only the throw is out of line.
+ */
+
+[[noreturn]] void throw_line_out_of_range();
+
+struct CheckedAccess
+{
+    static void check(size_t it, size_t size)
+    {
+        if (it >= size)
+        {
+            throw_line_out_of_range();
+        }
+    }
+};
+
+struct UncheckedAccess
+{
+    static void check(size_t, size_t) {}
+};
+
+/* Checked in debug builds, unchecked when NDEBUG is defined. */
+#ifdef NDEBUG
+using DefaultAccess = UncheckedAccess;
+#else
+using DefaultAccess = CheckedAccess;
+#endif
+
+/*
+ * Default allocator of the layouts: std::allocator, which also counts the
+ * line.alloc.calls and line.alloc.bytes instruments when they are built in.
+ */
+#ifdef LINE_INSTRUMENT
+template <typename T>
+struct LineAllocator : std::allocator<T>
+{
+    template <typename U>
+    struct rebind
+    {
+        using other = LineAllocator<U>;
+    };
+
+    LineAllocator() = default;
+    template <typename U>
+    LineAllocator(LineAllocator<U> const &) noexcept {}
+
+    T *allocate(size_t n)
+    {
+        INSTRUMENT_COUNT("line.alloc.calls", 1);
+        INSTRUMENT_COUNT("line.alloc.bytes", n * sizeof(T));
+        return std::allocator<T>::allocate(n);
+    }
+}; /* end struct LineAllocator */
+#else
+template <typename T>
+using LineAllocator = std::allocator<T>;
+#endif
+
+/*
+ * Coordinate layout policies.  A layout owns the coordinate storage and
+ * provides unchecked element access; Line adds the public interface on top.
+ * The allocator is passed through to the underlying vectors (see
+ * line_alloc.hpp for the arena and the pool).
+ */
+
+/* Interleaved (array-of-structures) layout: x0 y0 x1 y1 ... */
+template <typename Alloc = LineAllocator<float>>
+class AosLayout
+{
+public:
+    using allocator_type = Alloc;
+
+    AosLayout() = default;
+    AosLayout(size_t size) : m_coord(2 * size) {}
+    explicit AosLayout(Alloc const &alloc) : m_coord(alloc) {}
+    AosLayout(size_t size, Alloc const &alloc) : m_coord(2 * size, alloc) {}
+
+    allocator_type get_allocator() const { return m_coord.get_allocator(); }
+
+    size_t size() const { return m_coord.size() / 2; }
+    float &x(size_t it) { return m_coord[it * 2]; }
+    float const &x(size_t it) const { return m_coord[it * 2]; }
+    float &y(size_t it) { return m_coord[it * 2 + 1]; }
+    float const &y(size_t it) const { return m_coord[it * 2 + 1]; }
+
+    // Raw views.
+    float *data() { return m_coord.data(); }
+    float const *data() const { return m_coord.data(); }
+    StridedSpan<float> xs() { return {data(), size(), 2}; }
+    StridedSpan<float const> xs() const { return {data(), size(), 2}; }
+    StridedSpan<float> ys() { return {data() + 1, size(), 2}; }
+    StridedSpan<float const> ys() const { return {data() + 1, size(), 2}; }
+
+    // Capacity.
+    size_t capacity() const { return m_coord.capacity() / 2; }
+    void reserve(size_t size) { m_coord.reserve(2 * size); }
+    void resize(size_t size) { m_coord.resize(2 * size); }
+    void shrink_to_fit() { m_coord.shrink_to_fit(); }
+    void clear() { m_coord.clear(); }
+    void push_back(float x, float y)
+    {
+        m_coord.push_back(x);
+        m_coord.push_back(y);
+    }
+
+    // Overwrite the contents, reusing the allocation when it is big enough.
+    void assign(AosLayout const &other)
+    {
+        m_coord.assign(other.m_coord.begin(), other.m_coord.end());
+    }
+    void swap(AosLayout &other) { std::swap(m_coord, other.m_coord); }
+
+private:
+    std::vector<float, Alloc> m_coord;
+}; /* end class AosLayout */
+
+/* Separate (structure-of-arrays) layout: x0 x1 ... and y0 y1 ... */
+template <typename Alloc = LineAllocator<float>>
+class SoaLayout
+{
+public:
+    using allocator_type = Alloc;
+
+    SoaLayout() = default;
+    SoaLayout(size_t size) : m_x(size), m_y(size) {}
+    explicit SoaLayout(Alloc const &alloc) : m_x(alloc), m_y(alloc) {}
+    SoaLayout(size_t size, Alloc const &alloc) : m_x(size, alloc), m_y(size, alloc) {}
+
+    allocator_type get_allocator() const { return m_x.get_allocator(); }
+
+    size_t size() const { return m_x.size(); }
+    float &x(size_t it) { return m_x[it]; }
+    float const &x(size_t it) const { return m_x[it]; }
+    float &y(size_t it) { return m_y[it]; }
+    float const &y(size_t it) const { return m_y[it]; }
+
+    // Raw views.
+    StridedSpan<float> xs() { return {m_x.data(), size(), 1}; }
+    StridedSpan<float const> xs() const { return {m_x.data(), size(), 1}; }
+    StridedSpan<float> ys() { return {m_y.data(), size(), 1}; }
+    StridedSpan<float const> ys() const { return {m_y.data(), size(), 1}; }
+
+    // Capacity.
+    size_t capacity() const { return std::min(m_x.capacity(), m_y.capacity()); }
+    void reserve(size_t size)
+    {
+        m_x.reserve(size);
+        m_y.reserve(size);
+    }
+    void resize(size_t size)
+    {
+        m_x.resize(size);
+        m_y.resize(size);
+    }
+    void shrink_to_fit()
+    {
+        m_x.shrink_to_fit();
+        m_y.shrink_to_fit();
+    }
+    void clear()
+    {
+        m_x.clear();
+        m_y.clear();
+    }
+    void push_back(float x, float y)
+    {
+        m_x.push_back(x);
+        m_y.push_back(y);
+    }
+
+    // Overwrite the contents, reusing the allocations when they are big enough.
+    void assign(SoaLayout const &other)
+    {
+        m_x.assign(other.m_x.begin(), other.m_x.end());
+        m_y.assign(other.m_y.begin(), other.m_y.end());
+    }
+    void swap(SoaLayout &other)
+    {
+        std::swap(m_x, other.m_x);
+        std::swap(m_y, other.m_y);
+    }
+
+private:
+    std::vector<float, Alloc> m_x;
+    std::vector<float, Alloc> m_y;
+}; /* end class SoaLayout */
+
+/*
+ * Copy-on-write wrapper around another layout.  Copies share one buffer,
+ * so copying a line is O(1); the first mutable access through a copy
+ * (non-const x(), y(), xs(), ys() or data(), or any resize) gives it a
+ * private buffer first.  Const access never copies, so call read-only code
+ * through a const reference.  References taken before a copy was made see
+ * the shared buffer, not the detached one.  Lines sharing a buffer may be
+ * used from different threads like independent lines.
+ */
+template <typename Inner = AosLayout<>>
+class CowLayout
+{
+public:
+    using allocator_type = typename Inner::allocator_type;
+
+    CowLayout() : m_shared(empty()) {}
+    CowLayout(size_t size) : m_shared(std::make_shared<Inner>(size)) {}
+    explicit CowLayout(allocator_type const &alloc) : m_shared(std::make_shared<Inner>(alloc)) {}
+    CowLayout(size_t size, allocator_type const &alloc) : m_shared(std::make_shared<Inner>(size, alloc)) {}
+    CowLayout(CowLayout const &) = default;
+    // A moved-from layout is empty, not null.
+    CowLayout(CowLayout &&other) noexcept : m_shared(std::move(other.m_shared)) { other.m_shared = empty(); }
+
+    allocator_type get_allocator() const { return view().get_allocator(); }
+
+    size_t size() const { return view().size(); }
+    float &x(size_t it) { return mutate().x(it); }
+    float const &x(size_t it) const { return view().x(it); }
+    float &y(size_t it) { return mutate().y(it); }
+    float const &y(size_t it) const { return view().y(it); }
+
+    // Raw views.
+    template <typename I = Inner>
+    auto data() -> decltype(std::declval<I &>().data()) { return mutate().data(); }
+    template <typename I = Inner>
+    auto data() const -> decltype(std::declval<I const &>().data()) { return view().data(); }
+    StridedSpan<float> xs() { return mutate().xs(); }
+    StridedSpan<float const> xs() const { return view().xs(); }
+    StridedSpan<float> ys() { return mutate().ys(); }
+    StridedSpan<float const> ys() const { return view().ys(); }
+
+    // Capacity.
+    size_t capacity() const { return view().capacity(); }
+    void reserve(size_t size) { mutate().reserve(size); }
+    void resize(size_t size) { mutate().resize(size); }
+    void shrink_to_fit() { mutate().shrink_to_fit(); }
+    void clear() { mutate().clear(); }
+    void push_back(float x, float y) { mutate().push_back(x, y); }
+
+    // Assignment shares the other buffer instead of copying into this one.
+    void assign(CowLayout const &other) { m_shared = other.m_shared; }
+    void swap(CowLayout &other) { std::swap(m_shared, other.m_shared); }
+
+private:
+    // One empty buffer shared by every default-constructed layout.
+    static std::shared_ptr<Inner> const &empty()
+    {
+        static std::shared_ptr<Inner> const ret = std::make_shared<Inner>();
+        return ret;
+    }
+
+    Inner const &view() const { return *m_shared; }
+
+    Inner &mutate()
+    {
+        if (m_shared.use_count() > 1)
+        {
+            INSTRUMENT_COUNT("line.cow_detach", 1);
+            m_shared = std::make_shared<Inner>(*m_shared);
+        }
+        else
+        {
+            // Order the writes after the last reads through released copies.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return *m_shared;
+    }
+
+    std::shared_ptr<Inner> m_shared;
+}; /* end class CowLayout */
+
+template <typename Layout, typename Check = DefaultAccess>
+class BasicLine
+{
+public:
+    using layout_type = Layout;
+    using check_type = Check;
+    using allocator_type = typename Layout::allocator_type;
+
     // Basic constructors.
-    Line() = default;              // default constructor.
-    Line(Line const &);            // copy constructor.
-    Line(Line &&);                 // move constructor.
-    Line &operator=(Line const &); // copy assignment operator.
-    Line &operator=(Line &&);      // move assignment operator.
+    BasicLine() = default;                   // default constructor.
+    BasicLine(BasicLine const &);            // copy constructor.
+    BasicLine(BasicLine &&) noexcept;        // move constructor.
+    BasicLine &operator=(BasicLine const &); // copy assignment operator.
+    BasicLine &operator=(BasicLine &&) noexcept; // move assignment operator.
 
-    // Custom constructor.
-    Line(size_t size) : m_coord(2 * size) {}
+    // Custom constructors.
+    BasicLine(size_t size) : m_store(size) {}
+    explicit BasicLine(allocator_type const &alloc) : m_store(alloc) {}
+    BasicLine(size_t size, allocator_type const &alloc) : m_store(size, alloc) {}
 
     // Desctructor.
-    ~Line() = default;
+    ~BasicLine() = default;
 
     // Accessors.
-    size_t size() const { return m_coord.size() / 2; }
-    float const &x(size_t it) const;
-    float &x(size_t it);
-    float const &y(size_t it) const;
-    float &y(size_t it);
+    size_t size() const { return m_store.size(); }
+    allocator_type get_allocator() const { return m_store.get_allocator(); }
+    float const &x(size_t it) const
+    {
+        Check::check(it, size());
+        return m_store.x(it);
+    }
+    float &x(size_t it)
+    {
+        Check::check(it, size());
+        return m_store.x(it);
+    }
+    float const &y(size_t it) const
+    {
+        Check::check(it, size());
+        return m_store.y(it);
+    }
+    float &y(size_t it)
+    {
+        Check::check(it, size());
+        return m_store.y(it);
+    }
+
+    // Bulk access to the storage, bypassing the range check.
+    StridedSpan<float> xs() { return m_store.xs(); }
+    StridedSpan<float const> xs() const { return m_store.xs(); }
+    StridedSpan<float> ys() { return m_store.ys(); }
+    StridedSpan<float const> ys() const { return m_store.ys(); }
+    // The interleaved buffer (2 * size() floats); AosLayout only.
+    template <typename L = Layout>
+    auto data() -> decltype(std::declval<L &>().data()) { return m_store.data(); }
+    template <typename L = Layout>
+    auto data() const -> decltype(std::declval<L const &>().data()) { return m_store.data(); }
+
+    // Capacity.  Scratch lines can be recycled without reallocating: resize()
+    // and clear() never release memory, only shrink_to_fit() does.
+    size_t capacity() const { return m_store.capacity(); }
+    void reserve(size_t size) { m_store.reserve(size); }
+    void resize(size_t size) { m_store.resize(size); }
+    void shrink_to_fit() { m_store.shrink_to_fit(); }
+    void clear() { m_store.clear(); }
+    void push_back(float x, float y) { m_store.push_back(x, y); }
 
 private:
-    // Private helper.
-    void check_range(size_t it) const;
     // Member data.
-    std::vector<float> m_coord;
-}; /* end class Line */
+    Layout m_store;
+}; /* end class BasicLine */
+
+using Line = BasicLine<AosLayout<>>;
+using SoaLine = BasicLine<SoaLayout<>>;
+// Opt-in copy-on-write line for cheap snapshots; see CowLayout.
+using CowLine = BasicLine<CowLayout<>>;
 
+/* The layouts with the default check are instantiated once in line.cpp. */
+extern template class BasicLine<AosLayout<>>;
+extern template class BasicLine<SoaLayout<>>;
+extern template class BasicLine<CowLayout<>>;
+
+/* Define the copy constructor */
+template <typename Layout, typename Check>
+BasicLine<Layout, Check>::BasicLine(BasicLine const &other)
+    : m_store(other.m_store)
+{
+    INSTRUMENT_COUNT("line.copy", 1);
+}
+
+/* Define the move constructor */
+template <typename Layout, typename Check>
+BasicLine<Layout, Check>::BasicLine(BasicLine &&other) noexcept
+    : m_store(std::move(other.m_store))
+{
+    INSTRUMENT_COUNT("line.move", 1);
+}
+
+/* Define the copy assignment operator */
+template <typename Layout, typename Check>
+BasicLine<Layout, Check> &BasicLine<Layout, Check>::operator=(BasicLine const &other)
+{
+    if (this == &other)
+    {
+        return *this;
+    } // don't copy to self.
+    INSTRUMENT_COUNT("line.copy_assign", 1);
+    m_store.assign(other.m_store);
+    return *this;
+}
+
+/* Define the move assignment operator */
+template <typename Layout, typename Check>
+BasicLine<Layout, Check> &BasicLine<Layout, Check>::operator=(BasicLine &&other) noexcept
+{
+    if (this == &other)
+    {
+        return *this;
+    } // don't move to self.
+    INSTRUMENT_COUNT("line.move_assign", 1);
+    m_store.swap(other.m_store);
+    return *this;
+}
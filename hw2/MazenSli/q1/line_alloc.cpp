@@ -0,0 +1,125 @@
+#include "line_alloc.hpp"
+
+namespace
+{
+
+size_t align_up(size_t value, size_t align)
+{
+    return (value + align - 1) / align * align;
+}
+
+char *new_chunk(size_t bytes)
+{
+    return static_cast<char *>(::operator new(bytes));
+}
+
+} /* end namespace */
+
+/* Define the arena */
+LineArena::LineArena(size_t chunk_bytes)
+    : m_chunk_bytes(chunk_bytes)
+{
+}
+
+LineArena::~LineArena()
+{
+    for (Chunk &chunk : m_chunks)
+    {
+        ::operator delete(chunk.data);
+    }
+}
+
+void *LineArena::allocate(size_t bytes, size_t align)
+{
+    if (align > alignof(std::max_align_t))
+    {
+        throw std::bad_alloc();
+    }
+    while (m_current < m_chunks.size())
+    {
+        size_t begin = align_up(m_offset, align);
+        if (begin + bytes <= m_chunks[m_current].size)
+        {
+            m_offset = begin + bytes;
+            return m_chunks[m_current].data + begin;
+        }
+        // Move on to the next retained chunk.
+        ++m_current;
+        m_offset = 0;
+    }
+    // Out of retained chunks: oversized requests get a chunk of their own.
+    Chunk chunk{nullptr, std::max(bytes, m_chunk_bytes)};
+    chunk.data = new_chunk(chunk.size);
+    m_chunks.push_back(chunk);
+    m_current = m_chunks.size() - 1;
+    m_offset = bytes;
+    return chunk.data;
+}
+
+void LineArena::reset()
+{
+    m_current = 0;
+    m_offset = 0;
+}
+
+size_t LineArena::bytes_reserved() const
+{
+    size_t total = 0;
+    for (Chunk const &chunk : m_chunks)
+    {
+        total += chunk.size;
+    }
+    return total;
+}
+
+/* Define the pool */
+LinePool::LinePool(size_t block_bytes, size_t blocks_per_chunk)
+    : m_block_bytes(align_up(std::max(block_bytes, sizeof(FreeBlock)), alignof(std::max_align_t))), m_blocks_per_chunk(std::max<size_t>(blocks_per_chunk, 1))
+{
+}
+
+LinePool::~LinePool()
+{
+    for (char *chunk : m_chunks)
+    {
+        ::operator delete(chunk);
+    }
+}
+
+void *LinePool::allocate(size_t bytes, size_t align)
+{
+    if (bytes > m_block_bytes || align > alignof(std::max_align_t))
+    {
+        throw std::bad_alloc();
+    }
+    if (m_free)
+    {
+        FreeBlock *block = m_free;
+        m_free = block->next;
+        return block;
+    }
+    if (m_current < m_chunks.size() && m_carved == m_blocks_per_chunk)
+    {
+        ++m_current;
+        m_carved = 0;
+    }
+    if (m_current == m_chunks.size())
+    {
+        m_chunks.push_back(new_chunk(m_block_bytes * m_blocks_per_chunk));
+    }
+    return m_chunks[m_current] + m_block_bytes * m_carved++;
+}
+
+void LinePool::deallocate(void *ptr, size_t)
+{
+    FreeBlock *block = static_cast<FreeBlock *>(ptr);
+    block->next = m_free;
+    m_free = block;
+}
+
+void LinePool::reset()
+{
+    m_free = nullptr;
+    m_current = 0;
+    m_carved = 0;
+}
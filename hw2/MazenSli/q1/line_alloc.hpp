@@ -0,0 +1,142 @@
+#pragma once
+
+#include "line.hpp"
+
+#include <cstddef> // for max_align_t
+#include <new>     // for bad_alloc
+#include <type_traits>
+
+/*
+ * Memory resources for short-lived lines.  Neither resource is thread-safe;
+ * use one per request or per worker thread.
+ */
+
+/*
+ * Monotonic arena.  Allocation bumps a pointer inside the current chunk and
+ * deallocation is a no-op; reset() releases everything at once and keeps the
+ * chunks for the next batch, so a steady-state workload stops calling malloc.
+ * Every line allocated from the arena must be gone (or never touched again)
+ * before reset().
+ */
+class LineArena
+{
+public:
+    explicit LineArena(size_t chunk_bytes = 1 << 20);
+    LineArena(LineArena const &) = delete;
+    LineArena &operator=(LineArena const &) = delete;
+    ~LineArena();
+
+    void *allocate(size_t bytes, size_t align);
+    void deallocate(void *, size_t) {}
+    void reset();
+
+    size_t chunk_count() const { return m_chunks.size(); }
+    size_t bytes_reserved() const;
+
+private:
+    struct Chunk
+    {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Chunk> m_chunks;
+    size_t m_current = 0; // index of the chunk being bumped.
+    size_t m_offset = 0;  // first free byte in the current chunk.
+    size_t m_chunk_bytes;
+}; /* end class LineArena */
+
+/*
+ * Fixed-size block pool.  Every allocation takes one block of block_bytes,
+ * so it fits lines whose point count is bounded and reserved up front
+ * (2 * max_points * sizeof(float) for the interleaved layout).  Freed blocks
+ * go on a free list; reset() returns all blocks at once.
+ */
+class LinePool
+{
+public:
+    explicit LinePool(size_t block_bytes, size_t blocks_per_chunk = 1024);
+    LinePool(LinePool const &) = delete;
+    LinePool &operator=(LinePool const &) = delete;
+    ~LinePool();
+
+    void *allocate(size_t bytes, size_t align);
+    void deallocate(void *ptr, size_t bytes);
+    void reset();
+
+    size_t block_size() const { return m_block_bytes; }
+    size_t chunk_count() const { return m_chunks.size(); }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    std::vector<char *> m_chunks;
+    FreeBlock *m_free = nullptr;
+    size_t m_current = 0; // index of the chunk being carved.
+    size_t m_carved = 0;  // blocks already handed out from the current chunk.
+    size_t m_block_bytes;
+    size_t m_blocks_per_chunk;
+}; /* end class LinePool */
+
+/*
+ * Standard allocator handing out memory from a LineArena or a LinePool.  The
+ * allocator follows a moved or swapped line, but copy assignment keeps the
+ * destination's resource so recycled scratch lines stay where they are.
+ */
+template <typename T, typename Resource>
+class ResourceAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = ResourceAllocator<U, Resource>;
+    };
+
+    explicit ResourceAllocator(Resource &resource) noexcept : m_resource(&resource) {}
+    template <typename U>
+    ResourceAllocator(ResourceAllocator<U, Resource> const &other) noexcept
+        : m_resource(other.resource()) {}
+
+    T *allocate(size_t n)
+    {
+        INSTRUMENT_COUNT("line.alloc.calls", 1);
+        INSTRUMENT_COUNT("line.alloc.bytes", n * sizeof(T));
+        return static_cast<T *>(m_resource->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *ptr, size_t n) { m_resource->deallocate(ptr, n * sizeof(T)); }
+
+    Resource *resource() const { return m_resource; }
+
+private:
+    Resource *m_resource;
+}; /* end class ResourceAllocator */
+
+template <typename T, typename U, typename Resource>
+bool operator==(ResourceAllocator<T, Resource> const &lhs, ResourceAllocator<U, Resource> const &rhs)
+{
+    return lhs.resource() == rhs.resource();
+}
+
+template <typename T, typename U, typename Resource>
+bool operator!=(ResourceAllocator<T, Resource> const &lhs, ResourceAllocator<U, Resource> const &rhs)
+{
+    return !(lhs == rhs);
+}
+
+template <typename T>
+using ArenaAllocator = ResourceAllocator<T, LineArena>;
+template <typename T>
+using PoolAllocator = ResourceAllocator<T, LinePool>;
+
+using ArenaLine = BasicLine<AosLayout<ArenaAllocator<float>>>;
+using PoolLine = BasicLine<AosLayout<PoolAllocator<float>>>;
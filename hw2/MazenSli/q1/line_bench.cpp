@@ -0,0 +1,132 @@
+#include "line_kernels.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+/* Best-of-repeat wall time of fn() in milliseconds */
+template <typename F>
+double time_ms(F fn, int repeat = 5)
+{
+    double best = HUGE_VAL;
+    for (int it = 0; it < repeat; ++it)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+/* The loops every consumer wrote before the kernels existed */
+template <typename L>
+double naive_length(L const &line)
+{
+    double ret = 0;
+    for (size_t it = 1; it < line.size(); ++it)
+    {
+        float dx = line.x(it) - line.x(it - 1);
+        float dy = line.y(it) - line.y(it - 1);
+        ret += std::sqrt(dx * dx + dy * dy);
+    }
+    return ret;
+}
+
+template <typename L>
+BoundingBox naive_bounding_box(L const &line)
+{
+    BoundingBox ret{HUGE_VALF, HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+    for (size_t it = 0; it < line.size(); ++it)
+    {
+        ret.xmin = std::min(ret.xmin, line.x(it));
+        ret.ymin = std::min(ret.ymin, line.y(it));
+        ret.xmax = std::max(ret.xmax, line.x(it));
+        ret.ymax = std::max(ret.ymax, line.y(it));
+    }
+    return ret;
+}
+
+template <typename L>
+void naive_rotate(L &line, float radians)
+{
+    float c = std::cos(radians), s = std::sin(radians);
+    for (size_t it = 0; it < line.size(); ++it)
+    {
+        float x = line.x(it), y = line.y(it);
+        line.x(it) = c * x - s * y;
+        line.y(it) = s * x + c * y;
+    }
+}
+
+template <typename L>
+void run(char const *name, size_t npoint)
+{
+    L line(npoint);
+    for (size_t it = 0; it < npoint; ++it)
+    {
+        line.x(it) = std::sin(0.001f * it) * 100;
+        line.y(it) = std::cos(0.003f * it) * 100;
+    }
+
+    // Sinks keep the compiler from dropping the timed work.
+    volatile double sink = 0;
+    double naive[3] = {
+        time_ms([&] { sink = naive_length(line); }),
+        time_ms([&] { sink = naive_bounding_box(line).xmin; }),
+        time_ms([&] { naive_rotate(line, 0.001f); }),
+    };
+
+    std::printf("%s, %zu points: naive length %.3f ms, bounding box %.3f ms, rotate %.3f ms\n",
+                name, npoint, naive[0], naive[1], naive[2]);
+    for (char const *isa : {"scalar", "sse2", "avx2", "neon"})
+    {
+        if (!set_line_kernel_isa(isa))
+        {
+            continue;
+        }
+        double kernel[3] = {
+            time_ms([&] { sink = length(line); }),
+            time_ms([&] { sink = bounding_box(line).xmin; }),
+            time_ms([&] { rotate(line, 0.001f); }),
+        };
+        std::printf("  %-6s  length %.3f ms (%.2fx)  bounding box %.3f ms (%.2fx)  rotate %.3f ms (%.2fx)\n",
+                    isa, kernel[0], naive[0] / kernel[0], kernel[1], naive[1] / kernel[1],
+                    kernel[2], naive[2] / kernel[2]);
+    }
+}
+
+/* A history of snapshots of one line, one in ten of them changed */
+template <typename L>
+void run_snapshots(char const *name, size_t npoint, size_t nsnapshot)
+{
+    L line(npoint);
+    std::vector<L> history;
+    history.reserve(nsnapshot);
+    double ms = time_ms([&] {
+        history.clear();
+        for (size_t it = 0; it < nsnapshot; ++it)
+        {
+            history.push_back(line);
+            if (0 == it % 10)
+            {
+                history.back().x(0) = float(it);
+            }
+        }
+    }, 1);
+    std::printf("%s, %zu snapshots of %zu points: %.3f ms\n", name, nsnapshot, npoint, ms);
+}
+
+int main(int, char **)
+{
+    size_t const npoint = 4 << 20;
+    run<Line>("Line", npoint);
+    run<SoaLine>("SoaLine", npoint);
+    run_snapshots<Line>("Line", 1 << 16, 1000);
+    run_snapshots<CowLine>("CowLine", 1 << 16, 1000);
+    for (auto const &counter : instrument::snapshot())
+    {
+        std::printf("%s %llu\n", counter.first.c_str(), static_cast<unsigned long long>(counter.second));
+    }
+    return 0;
+}
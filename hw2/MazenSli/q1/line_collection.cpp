@@ -0,0 +1,48 @@
+#include "line_collection.hpp"
+
+LineView LineCollection::at(size_t it)
+{
+    CheckedAccess::check(it, size());
+    return (*this)[it];
+}
+
+ConstLineView LineCollection::at(size_t it) const
+{
+    CheckedAccess::check(it, size());
+    return (*this)[it];
+}
+
+/* Append a line of npoint zero-initialized points */
+LineView LineCollection::append(size_t npoint)
+{
+    size_t begin = point_count();
+    m_coord.resize(2 * (begin + npoint));
+    m_offsets.push_back(begin + npoint);
+    return {m_coord.data() + 2 * begin, npoint};
+}
+
+Line LineCollection::line(size_t it) const
+{
+    ConstLineView view = at(it);
+    Line ret(view.size());
+    std::copy(view.data(), view.data() + 2 * view.size(), ret.data());
+    return ret;
+}
+
+void LineCollection::reserve(size_t nline, size_t npoint)
+{
+    m_offsets.reserve(nline + 1);
+    m_coord.reserve(2 * npoint);
+}
+
+void LineCollection::clear()
+{
+    m_coord.clear();
+    m_offsets.resize(1);
+}
+
+void LineCollection::shrink_to_fit()
+{
+    m_coord.shrink_to_fit();
+    m_offsets.shrink_to_fit();
+}
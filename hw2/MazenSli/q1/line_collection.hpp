@@ -0,0 +1,175 @@
+#pragma once
+
+#include "line.hpp"
+
+#include <functional> // for less
+
+/*
+ * Non-owning view of one line stored in a LineCollection.  It has the same
+ * accessors as Line; the coordinates are interleaved like AosLayout.
+ */
+template <typename T, typename Check = DefaultAccess>
+class BasicLineView
+{
+public:
+    BasicLineView(T *coord, size_t size) : m_coord(coord), m_size(size) {}
+    // A mutable view converts to a const one.
+    template <typename U>
+    BasicLineView(BasicLineView<U, Check> const &other)
+        : m_coord(other.data()), m_size(other.size()) {}
+
+    size_t size() const { return m_size; }
+    T &x(size_t it) const
+    {
+        Check::check(it, m_size);
+        return m_coord[it * 2];
+    }
+    T &y(size_t it) const
+    {
+        Check::check(it, m_size);
+        return m_coord[it * 2 + 1];
+    }
+
+    T *data() const { return m_coord; }
+    StridedSpan<T> xs() const { return {m_coord, m_size, 2}; }
+    StridedSpan<T> ys() const { return {m_coord + 1, m_size, 2}; }
+
+private:
+    T *m_coord;
+    size_t m_size;
+}; /* end class BasicLineView */
+
+using LineView = BasicLineView<float>;
+using ConstLineView = BasicLineView<float const>;
+
+/* Iterator over the lines of a collection, yielding views by value. */
+template <typename Collection, typename View>
+class LineCollectionIterator
+{
+public:
+    LineCollectionIterator(Collection *collection, size_t it)
+        : m_collection(collection), m_it(it) {}
+
+    View operator*() const { return (*m_collection)[m_it]; }
+    LineCollectionIterator &operator++()
+    {
+        ++m_it;
+        return *this;
+    }
+    bool operator==(LineCollectionIterator const &other) const { return m_it == other.m_it; }
+    bool operator!=(LineCollectionIterator const &other) const { return m_it != other.m_it; }
+
+private:
+    Collection *m_collection;
+    size_t m_it;
+}; /* end class LineCollectionIterator */
+
+/*
+ * Many lines in one contiguous buffer (compressed-sparse-row style).  The
+ * points of every line are interleaved back to back in one coordinate array;
+ * line i owns points [offsets()[i], offsets()[i+1]).
+ */
+class LineCollection
+{
+public:
+    using iterator = LineCollectionIterator<LineCollection, LineView>;
+    using const_iterator = LineCollectionIterator<LineCollection const, ConstLineView>;
+
+    LineCollection() : m_offsets(1, 0) {}
+    template <typename L>
+    explicit LineCollection(std::vector<L> const &lines);
+
+    // Accessors.
+    size_t size() const { return m_offsets.size() - 1; }
+    bool empty() const { return 0 == size(); }
+    size_t point_count() const { return m_offsets.back(); }
+    size_t line_size(size_t it) const { return m_offsets[it + 1] - m_offsets[it]; }
+    LineView operator[](size_t it)
+    {
+        return {m_coord.data() + 2 * m_offsets[it], line_size(it)};
+    }
+    ConstLineView operator[](size_t it) const
+    {
+        return {m_coord.data() + 2 * m_offsets[it], line_size(it)};
+    }
+    LineView at(size_t it);
+    ConstLineView at(size_t it) const;
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, size()}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+
+    // Bulk access: 2 * point_count() interleaved floats and size() + 1 offsets.
+    float *data() { return m_coord.data(); }
+    float const *data() const { return m_coord.data(); }
+    size_t const *offsets() const { return m_offsets.data(); }
+
+    // Appending.
+    LineView append(size_t npoint);
+    template <typename Layout, typename Check>
+    LineView append(BasicLine<Layout, Check> const &line);
+    template <typename T, typename Check>
+    LineView append(BasicLineView<T, Check> const &line);
+
+    // Copy one line out into an owning Line.
+    Line line(size_t it) const;
+
+    // Capacity.  reserve() takes totals, like std::vector: room for nline
+    // lines and npoint points in all, not for that many more.
+    void reserve(size_t nline, size_t npoint);
+    void clear();
+    void shrink_to_fit();
+
+private:
+    std::vector<float> m_coord;
+    std::vector<size_t> m_offsets;
+}; /* end class LineCollection */
+
+template <typename L>
+LineCollection::LineCollection(std::vector<L> const &lines)
+    : m_offsets(1, 0)
+{
+    size_t npoint = 0;
+    for (L const &line : lines)
+    {
+        npoint += line.size();
+    }
+    reserve(lines.size(), npoint);
+    for (L const &line : lines)
+    {
+        append(line);
+    }
+}
+
+template <typename Layout, typename Check>
+LineView LineCollection::append(BasicLine<Layout, Check> const &line)
+{
+    LineView view = append(line.size());
+    StridedSpan<float const> xs = line.xs();
+    StridedSpan<float const> ys = line.ys();
+    float *coord = view.data();
+    for (size_t it = 0; it < xs.size(); ++it)
+    {
+        coord[it * 2] = xs[it];
+        coord[it * 2 + 1] = ys[it];
+    }
+    return view;
+}
+
+template <typename T, typename Check>
+LineView LineCollection::append(BasicLineView<T, Check> const &line)
+{
+    // The source may be a view into this collection, which append() moves.
+    float const *src = line.data();
+    float const *begin = m_coord.data();
+    bool aliased = std::less_equal<float const *>()(begin, src) && std::less<float const *>()(src, begin + m_coord.size());
+    size_t offset = aliased ? src - begin : 0;
+    LineView view = append(line.size());
+    if (aliased)
+    {
+        src = m_coord.data() + offset;
+    }
+    std::copy(src, src + 2 * line.size(), view.data());
+    return view;
+}
@@ -0,0 +1,275 @@
+#include "line_io.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+char const line_file_magic[8] = {'N', 'S', 'D', 'L', 'I', 'N', 'E', '\0'};
+
+uint64_t align_up(uint64_t value)
+{
+    return (value + line_file_alignment - 1) / line_file_alignment * line_file_alignment;
+}
+
+void fail(std::string const &path, char const *what)
+{
+    throw std::runtime_error("line file " + path + ": " + what);
+}
+
+} /* end namespace */
+
+void write_lines(std::string const &path, LineCollection const &lines)
+{
+    LineFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, line_file_magic, sizeof(header.magic));
+    header.version = line_file_version;
+    header.byte_order = line_file_byte_order;
+    header.coord_size = sizeof(float);
+    header.nline = lines.size();
+    header.npoint = lines.point_count();
+    header.offsets_offset = sizeof(header);
+    header.coord_offset = align_up(header.offsets_offset + sizeof(uint64_t) * (header.nline + 1));
+
+    std::vector<uint64_t> offsets(lines.offsets(), lines.offsets() + lines.size() + 1);
+    std::vector<char> padding(header.coord_offset - header.offsets_offset - sizeof(uint64_t) * offsets.size(), 0);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        fail(path, "cannot open for writing");
+    }
+    out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+    out.write(reinterpret_cast<char const *>(offsets.data()), sizeof(uint64_t) * offsets.size());
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<char const *>(lines.data()), sizeof(float) * 2 * lines.point_count());
+    out.close();
+    if (!out)
+    {
+        fail(path, "write failed");
+    }
+}
+
+/* Define the mapped reader */
+MappedLines::MappedLines(std::string const &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        fail(path, "cannot open for reading");
+    }
+    struct stat st;
+    if (::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(LineFileHeader))
+    {
+        ::close(fd);
+        fail(path, "too short for a header");
+    }
+    m_map_size = st.st_size;
+    m_map = ::mmap(nullptr, m_map_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive.
+    if (MAP_FAILED == m_map)
+    {
+        m_map = nullptr;
+        fail(path, "mmap failed");
+    }
+
+    LineFileHeader const &header = *static_cast<LineFileHeader const *>(m_map);
+    char const *bad = nullptr;
+    if (0 != std::memcmp(header.magic, line_file_magic, sizeof(header.magic)))
+    {
+        bad = "bad magic";
+    }
+    else if (line_file_version != header.version)
+    {
+        bad = "unsupported version";
+    }
+    else if (line_file_byte_order != header.byte_order || sizeof(float) != header.coord_size)
+    {
+        bad = "incompatible byte order or float size";
+    }
+    else if (header.offsets_offset % alignof(uint64_t) || header.coord_offset % alignof(float) ||
+             header.nline >= m_map_size / sizeof(uint64_t) || header.npoint > m_map_size / (2 * sizeof(float)) ||
+             header.offsets_offset > m_map_size || header.coord_offset > m_map_size ||
+             sizeof(uint64_t) * (header.nline + 1) > m_map_size - header.offsets_offset ||
+             sizeof(float) * 2 * header.npoint > m_map_size - header.coord_offset)
+    {
+        bad = "arrays out of bounds";
+    }
+    if (!bad)
+    {
+        char const *base = static_cast<char const *>(m_map);
+        m_nline = header.nline;
+        m_npoint = header.npoint;
+        m_offsets = reinterpret_cast<uint64_t const *>(base + header.offsets_offset);
+        m_coord = reinterpret_cast<float const *>(base + header.coord_offset);
+        // One pass over the offsets so every view is in bounds.
+        if (0 != m_offsets[0] || m_npoint != m_offsets[m_nline])
+        {
+            bad = "inconsistent offsets";
+        }
+        for (size_t it = 0; !bad && it < m_nline; ++it)
+        {
+            if (m_offsets[it] > m_offsets[it + 1])
+            {
+                bad = "inconsistent offsets";
+            }
+        }
+    }
+    if (bad)
+    {
+        unmap();
+        fail(path, bad);
+    }
+}
+
+MappedLines::MappedLines(MappedLines &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedLines &MappedLines::operator=(MappedLines &&other) noexcept
+{
+    if (this == &other)
+    {
+        return *this;
+    } // don't move to self.
+    unmap();
+    std::swap(m_map, other.m_map);
+    std::swap(m_map_size, other.m_map_size);
+    std::swap(m_nline, other.m_nline);
+    std::swap(m_npoint, other.m_npoint);
+    std::swap(m_offsets, other.m_offsets);
+    std::swap(m_coord, other.m_coord);
+    return *this;
+}
+
+MappedLines::~MappedLines()
+{
+    unmap();
+}
+
+void MappedLines::unmap()
+{
+    if (m_map)
+    {
+        ::munmap(m_map, m_map_size);
+    }
+    m_map = nullptr;
+    m_map_size = 0;
+    m_nline = 0;
+    m_npoint = 0;
+    m_offsets = nullptr;
+    m_coord = nullptr;
+}
+
+ConstLineView MappedLines::at(size_t it) const
+{
+    CheckedAccess::check(it, size());
+    return (*this)[it];
+}
+
+Line MappedLines::line(size_t it) const
+{
+    ConstLineView view = at(it);
+    Line ret(view.size());
+    std::copy(view.data(), view.data() + 2 * view.size(), ret.data());
+    return ret;
+}
+
+LineCollection MappedLines::collection() const
+{
+    LineCollection ret;
+    ret.reserve(size(), point_count());
+    for (ConstLineView view : *this)
+    {
+        ret.append(view);
+    }
+    return ret;
+}
+
+/* Define the text writer */
+LineTextWriter::LineTextWriter(std::ostream &out, size_t buffer_size)
+    : m_out(out), m_buffer(std::max<size_t>(buffer_size, 256))
+{
+}
+
+LineTextWriter::~LineTextWriter()
+{
+    flush();
+}
+
+void LineTextWriter::write_header(char const *name, size_t npoint)
+{
+    static char const text[] = ": number of points = ";
+    append(name, std::strlen(name));
+    append(text, sizeof(text) - 1);
+    append(npoint);
+    append("\n", 1);
+}
+
+void LineTextWriter::write_point(size_t it, float x, float y)
+{
+    // Longest point: 20-digit index and two 13-char floats, plus the text.
+    reserve(80);
+    append("point ", 6);
+    append(it);
+    append(": x = ", 6);
+    append(x);
+    append(" y = ", 5);
+    append(y);
+    append("\n", 1);
+}
+
+void LineTextWriter::flush()
+{
+    if (m_used)
+    {
+        m_out.write(m_buffer.data(), m_used);
+        m_used = 0;
+    }
+    m_out.flush();
+}
+
+void LineTextWriter::reserve(size_t len)
+{
+    if (m_used + len > m_buffer.size())
+    {
+        m_out.write(m_buffer.data(), m_used);
+        m_used = 0;
+        if (len > m_buffer.size())
+        {
+            m_buffer.resize(len);
+        }
+    }
+}
+
+void LineTextWriter::append(char const *str, size_t len)
+{
+    reserve(len);
+    std::memcpy(m_buffer.data() + m_used, str, len);
+    m_used += len;
+}
+
+void LineTextWriter::append(size_t value)
+{
+    reserve(20);
+    char *begin = m_buffer.data() + m_used;
+    m_used = std::to_chars(begin, begin + 20, value).ptr - m_buffer.data();
+}
+
+void LineTextWriter::append(float value)
+{
+    // %g with precision 6 is at most 13 characters ("-1.23457e+38").
+    reserve(16);
+    char *begin = m_buffer.data() + m_used;
+    m_used = std::to_chars(begin, begin + 16, value, std::chars_format::general, 6).ptr - m_buffer.data();
+}
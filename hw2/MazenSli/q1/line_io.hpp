@@ -0,0 +1,141 @@
+#pragma once
+
+#include "line.hpp"
+#include "line_collection.hpp"
+
+#include <cstdint>
+#include <ostream>
+
+/*
+ * Binary on-disk format for lines, read back through mmap with no parsing and
+ * no copy.  Fields are in host byte order; byte_order lets a reader reject a
+ * file written on a host of the other endianness.
+ *
+ *   header     64 bytes (LineFileHeader)
+ *   offsets    uint64[nline + 1], starting at offsets_offset
+ *   coord      float32[2 * npoint] interleaved x/y, starting at coord_offset
+ *
+ * Both arrays start on a 64-byte boundary.  A single Line is stored as a
+ * collection of one line.
+ */
+struct LineFileHeader
+{
+    char magic[8];           // "NSDLINE" and a NUL.
+    uint32_t version;        // line_file_version.
+    uint32_t byte_order;     // line_file_byte_order as written by the host.
+    uint32_t coord_size;     // sizeof(float).
+    uint32_t reserved;
+    uint64_t nline;
+    uint64_t npoint;
+    uint64_t offsets_offset; // byte offset of the offsets array.
+    uint64_t coord_offset;   // byte offset of the coordinate array.
+    char padding[8];
+};
+static_assert(sizeof(LineFileHeader) == 64, "line file header must be 64 bytes");
+
+constexpr uint32_t line_file_version = 1;
+constexpr uint32_t line_file_byte_order = 0x01020304;
+constexpr size_t line_file_alignment = 64;
+
+// Writers.  Throw std::runtime_error on I/O failure.
+void write_lines(std::string const &path, LineCollection const &lines);
+template <typename L>
+void write_line(std::string const &path, L const &line)
+{
+    LineCollection lines;
+    lines.append(line);
+    write_lines(path, lines);
+}
+
+/*
+ * Read-only memory map of a line file.  Views point straight into the
+ * mapping and stay valid for the lifetime of the MappedLines.
+ */
+class MappedLines
+{
+public:
+    using const_iterator = LineCollectionIterator<MappedLines const, ConstLineView>;
+
+    // Throws std::runtime_error when the file cannot be mapped or is not a
+    // valid line file of this version.
+    explicit MappedLines(std::string const &path);
+    MappedLines(MappedLines const &) = delete;
+    MappedLines &operator=(MappedLines const &) = delete;
+    MappedLines(MappedLines &&other) noexcept;
+    MappedLines &operator=(MappedLines &&other) noexcept;
+    ~MappedLines();
+
+    // Accessors, mirroring LineCollection.
+    size_t size() const { return m_nline; }
+    bool empty() const { return 0 == m_nline; }
+    size_t point_count() const { return m_npoint; }
+    size_t line_size(size_t it) const { return m_offsets[it + 1] - m_offsets[it]; }
+    ConstLineView operator[](size_t it) const
+    {
+        return {m_coord + 2 * m_offsets[it], line_size(it)};
+    }
+    ConstLineView at(size_t it) const;
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, size()}; }
+
+    float const *data() const { return m_coord; }
+    uint64_t const *offsets() const { return m_offsets; }
+
+    // Copy out.
+    Line line(size_t it) const;
+    LineCollection collection() const;
+
+private:
+    void unmap();
+
+    void *m_map = nullptr;
+    size_t m_map_size = 0;
+    size_t m_nline = 0;
+    size_t m_npoint = 0;
+    uint64_t const *m_offsets = nullptr;
+    float const *m_coord = nullptr;
+}; /* end class MappedLines */
+
+/*
+ * Buffered text output in the format main.cpp has always printed:
+ *
+ *   line: number of points = 3
+ *   point 0: x = 0 y = 1
+ *
+ * Numbers are formatted with std::to_chars (6 significant digits, like the
+ * default ostream formatting) into a reusable buffer, which goes to the
+ * stream in large chunks instead of one flush per point.
+ */
+class LineTextWriter
+{
+public:
+    explicit LineTextWriter(std::ostream &out, size_t buffer_size = 1 << 16);
+    LineTextWriter(LineTextWriter const &) = delete;
+    LineTextWriter &operator=(LineTextWriter const &) = delete;
+    ~LineTextWriter();
+
+    template <typename L>
+    void write(char const *name, L const &line)
+    {
+        write_header(name, line.size());
+        StridedSpan<float const> xs = line.xs();
+        StridedSpan<float const> ys = line.ys();
+        for (size_t it = 0; it < xs.size(); ++it)
+        {
+            write_point(it, xs[it], ys[it]);
+        }
+    }
+    void write_header(char const *name, size_t npoint);
+    void write_point(size_t it, float x, float y);
+    void flush();
+
+private:
+    void append(char const *str, size_t len);
+    void append(size_t value);
+    void append(float value);
+    void reserve(size_t len);
+
+    std::ostream &m_out;
+    std::vector<char> m_buffer;
+    size_t m_used = 0;
+}; /* end class LineTextWriter */
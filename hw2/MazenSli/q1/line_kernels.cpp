@@ -0,0 +1,397 @@
+#include "line_simd.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+/* Plain loops: the fallback, and the reference the vector kernels match. */
+struct ScalarKernels
+{
+    static void bounding_box_interleaved(float const *coord, size_t npoint, BoundingBox *box)
+    {
+        BoundingBox ret{HUGE_VALF, HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+        for (size_t it = 0; it < npoint; ++it)
+        {
+            float x = coord[2 * it], y = coord[2 * it + 1];
+            ret.xmin = x < ret.xmin ? x : ret.xmin;
+            ret.ymin = y < ret.ymin ? y : ret.ymin;
+            ret.xmax = x > ret.xmax ? x : ret.xmax;
+            ret.ymax = y > ret.ymax ? y : ret.ymax;
+        }
+        *box = ret;
+    }
+
+    static void minmax(float const *a, size_t n, float *lo, float *hi)
+    {
+        float vlo = HUGE_VALF, vhi = -HUGE_VALF;
+        for (size_t it = 0; it < n; ++it)
+        {
+            vlo = a[it] < vlo ? a[it] : vlo;
+            vhi = a[it] > vhi ? a[it] : vhi;
+        }
+        *lo = vlo;
+        *hi = vhi;
+    }
+
+    static void sum_interleaved(float const *coord, size_t npoint, double *sx, double *sy)
+    {
+        double x = 0, y = 0;
+        for (size_t it = 0; it < npoint; ++it)
+        {
+            x += coord[2 * it];
+            y += coord[2 * it + 1];
+        }
+        *sx = x;
+        *sy = y;
+    }
+
+    static double sum(float const *a, size_t n)
+    {
+        double ret = 0;
+        for (size_t it = 0; it < n; ++it)
+        {
+            ret += a[it];
+        }
+        return ret;
+    }
+
+    static double length_interleaved(float const *coord, size_t npoint)
+    {
+        double ret = 0;
+        for (size_t it = 1; it < npoint; ++it)
+        {
+            float dx = coord[2 * it] - coord[2 * it - 2];
+            float dy = coord[2 * it + 1] - coord[2 * it - 1];
+            ret += sqrtf(dx * dx + dy * dy);
+        }
+        return ret;
+    }
+
+    static double length_planar(float const *x, float const *y, size_t npoint)
+    {
+        double ret = 0;
+        for (size_t it = 1; it < npoint; ++it)
+        {
+            float dx = x[it] - x[it - 1];
+            float dy = y[it] - y[it - 1];
+            ret += sqrtf(dx * dx + dy * dy);
+        }
+        return ret;
+    }
+
+    static void affine_interleaved(float *coord, size_t npoint, Affine const &op)
+    {
+        affine_strided(coord, coord + 1, npoint, 2, op);
+    }
+
+    static void affine_planar(float *x, float *y, size_t npoint, Affine const &op)
+    {
+        affine_strided(x, y, npoint, 1, op);
+    }
+
+    static void affine_strided(float *x, float *y, size_t npoint, ptrdiff_t stride, Affine const &op)
+    {
+        for (size_t it = 0; it < npoint; ++it)
+        {
+            float vx = x[it * stride], vy = y[it * stride];
+            x[it * stride] = vx * op.a + vy * op.b + op.tx;
+            y[it * stride] = vy * op.d + vx * op.c + op.ty;
+        }
+    }
+}; /* end struct ScalarKernels */
+
+#if defined(__x86_64__) || defined(_M_X64)
+/* SSE2 is part of the x86-64 baseline. */
+struct Sse2
+{
+    using reg = __m128;
+    using dreg = __m128d;
+    static constexpr size_t width = 4;
+
+    static reg load(float const *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm_storeu_ps(p, v); }
+    static reg set1(float a) { return _mm_set1_ps(a); }
+    static reg pairs(float a, float b) { return _mm_setr_ps(a, b, a, b); }
+    static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+    static reg sqrt(reg a) { return _mm_sqrt_ps(a); }
+    static reg swap_pairs(reg a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }
+
+    static dreg dzero() { return _mm_setzero_pd(); }
+    static dreg dadd(dreg a, dreg b) { return _mm_add_pd(a, b); }
+    static dreg cvt_lo(reg a) { return _mm_cvtps_pd(a); }
+    static dreg cvt_hi(reg a) { return _mm_cvtps_pd(_mm_movehl_ps(a, a)); }
+    static void dstore(double *p, dreg v) { _mm_storeu_pd(p, v); }
+}; /* end struct Sse2 */
+#endif
+
+#if defined(__aarch64__)
+/* Advanced SIMD is mandatory on AArch64. */
+struct Neon
+{
+    using reg = float32x4_t;
+    using dreg = float64x2_t;
+    static constexpr size_t width = 4;
+
+    static reg load(float const *p) { return vld1q_f32(p); }
+    static void store(float *p, reg v) { vst1q_f32(p, v); }
+    static reg set1(float a) { return vdupq_n_f32(a); }
+    static reg pairs(float a, float b)
+    {
+        float const v[4] = {a, b, a, b};
+        return vld1q_f32(v);
+    }
+    static reg add(reg a, reg b) { return vaddq_f32(a, b); }
+    static reg sub(reg a, reg b) { return vsubq_f32(a, b); }
+    static reg mul(reg a, reg b) { return vmulq_f32(a, b); }
+    static reg min(reg a, reg b) { return vminq_f32(a, b); }
+    static reg max(reg a, reg b) { return vmaxq_f32(a, b); }
+    static reg sqrt(reg a) { return vsqrtq_f32(a); }
+    static reg swap_pairs(reg a) { return vrev64q_f32(a); }
+
+    static dreg dzero() { return vdupq_n_f64(0); }
+    static dreg dadd(dreg a, dreg b) { return vaddq_f64(a, b); }
+    static dreg cvt_lo(reg a) { return vcvt_f64_f32(vget_low_f32(a)); }
+    static dreg cvt_hi(reg a) { return vcvt_high_f64_f32(a); }
+    static void dstore(double *p, dreg v) { vst1q_f64(p, v); }
+}; /* end struct Neon */
+#endif
+
+LineKernelTable const *default_kernels()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return &line_kernels_avx2();
+    }
+    return &line_kernels_sse2();
+#elif defined(__aarch64__)
+    return &line_kernels_neon();
+#else
+    return &line_kernels_scalar();
+#endif
+}
+
+LineKernelTable const *&active_kernels()
+{
+    static LineKernelTable const *ret = default_kernels();
+    return ret;
+}
+
+LineKernelTable const &kernels() { return *active_kernels(); }
+
+/* Spans of one AosLayout-style buffer: x at even, y at odd positions. */
+template <typename T>
+bool interleaved(StridedSpan<T> xs, StridedSpan<T> ys)
+{
+    return 2 == xs.stride() && 2 == ys.stride() && ys.data() == xs.data() + 1;
+}
+
+} /* end namespace */
+
+LineKernelTable const &line_kernels_scalar()
+{
+    static LineKernelTable const ret{
+        "scalar",
+        &ScalarKernels::bounding_box_interleaved,
+        &ScalarKernels::minmax,
+        &ScalarKernels::sum_interleaved,
+        &ScalarKernels::sum,
+        &ScalarKernels::length_interleaved,
+        &ScalarKernels::length_planar,
+        &ScalarKernels::affine_interleaved,
+        &ScalarKernels::affine_planar,
+    };
+    return ret;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+LineKernelTable const &line_kernels_sse2() { return SimdKernels<Sse2>::table("sse2"); }
+#endif
+
+#if defined(__aarch64__)
+LineKernelTable const &line_kernels_neon() { return SimdKernels<Neon>::table("neon"); }
+#endif
+
+Affine Affine::rotation(float radians)
+{
+    float c = cosf(radians), s = sinf(radians);
+    return {c, -s, s, c, 0, 0};
+}
+
+double length(StridedSpan<float const> xs, StridedSpan<float const> ys)
+{
+    INSTRUMENT_TIME("line_kernels.length");
+    if (interleaved(xs, ys))
+    {
+        return kernels().length_interleaved(xs.data(), xs.size());
+    }
+    if (xs.contiguous() && ys.contiguous())
+    {
+        return kernels().length_planar(xs.data(), ys.data(), xs.size());
+    }
+    double ret = 0;
+    for (size_t it = 1; it < xs.size(); ++it)
+    {
+        float dx = xs[it] - xs[it - 1];
+        float dy = ys[it] - ys[it - 1];
+        ret += sqrtf(dx * dx + dy * dy);
+    }
+    return ret;
+}
+
+BoundingBox bounding_box(StridedSpan<float const> xs, StridedSpan<float const> ys)
+{
+    INSTRUMENT_TIME("line_kernels.bounding_box");
+    BoundingBox ret;
+    if (interleaved(xs, ys))
+    {
+        kernels().bounding_box_interleaved(xs.data(), xs.size(), &ret);
+    }
+    else if (xs.contiguous() && ys.contiguous())
+    {
+        kernels().minmax(xs.data(), xs.size(), &ret.xmin, &ret.xmax);
+        kernels().minmax(ys.data(), ys.size(), &ret.ymin, &ret.ymax);
+    }
+    else
+    {
+        ret = {HUGE_VALF, HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+        for (size_t it = 0; it < xs.size(); ++it)
+        {
+            ret.xmin = std::min(ret.xmin, xs[it]);
+            ret.ymin = std::min(ret.ymin, ys[it]);
+            ret.xmax = std::max(ret.xmax, xs[it]);
+            ret.ymax = std::max(ret.ymax, ys[it]);
+        }
+    }
+    return ret;
+}
+
+Point centroid(StridedSpan<float const> xs, StridedSpan<float const> ys)
+{
+    INSTRUMENT_TIME("line_kernels.centroid");
+    double sx = 0, sy = 0;
+    if (interleaved(xs, ys))
+    {
+        kernels().sum_interleaved(xs.data(), xs.size(), &sx, &sy);
+    }
+    else if (xs.contiguous() && ys.contiguous())
+    {
+        sx = kernels().sum(xs.data(), xs.size());
+        sy = kernels().sum(ys.data(), ys.size());
+    }
+    else
+    {
+        for (size_t it = 0; it < xs.size(); ++it)
+        {
+            sx += xs[it];
+            sy += ys[it];
+        }
+    }
+    double n = static_cast<double>(xs.size());
+    return {static_cast<float>(sx / n), static_cast<float>(sy / n)};
+}
+
+void transform(StridedSpan<float> xs, StridedSpan<float> ys, Affine const &op)
+{
+    INSTRUMENT_TIME("line_kernels.transform");
+    if (interleaved(xs, ys))
+    {
+        kernels().affine_interleaved(xs.data(), xs.size(), op);
+    }
+    else if (xs.contiguous() && ys.contiguous())
+    {
+        kernels().affine_planar(xs.data(), ys.data(), xs.size(), op);
+    }
+    else
+    {
+        for (size_t it = 0; it < xs.size(); ++it)
+        {
+            float vx = xs[it], vy = ys[it];
+            xs[it] = vx * op.a + vy * op.b + op.tx;
+            ys[it] = vy * op.d + vx * op.c + op.ty;
+        }
+    }
+}
+
+void lengths(LineCollection const &lines, double *out)
+{
+    INSTRUMENT_TIME("line_kernels.collection.lengths");
+    LineKernelTable const &k = kernels();
+    size_t const *offsets = lines.offsets();
+    for (size_t it = 0; it < lines.size(); ++it)
+    {
+        out[it] = k.length_interleaved(lines.data() + 2 * offsets[it], offsets[it + 1] - offsets[it]);
+    }
+}
+
+BoundingBox bounding_box(LineCollection const &lines)
+{
+    INSTRUMENT_TIME("line_kernels.collection.bounding_box");
+    BoundingBox ret;
+    kernels().bounding_box_interleaved(lines.data(), lines.point_count(), &ret);
+    return ret;
+}
+
+Point centroid(LineCollection const &lines)
+{
+    INSTRUMENT_TIME("line_kernels.collection.centroid");
+    double sx = 0, sy = 0;
+    kernels().sum_interleaved(lines.data(), lines.point_count(), &sx, &sy);
+    double n = static_cast<double>(lines.point_count());
+    return {static_cast<float>(sx / n), static_cast<float>(sy / n)};
+}
+
+void transform(LineCollection &lines, Affine const &op)
+{
+    INSTRUMENT_TIME("line_kernels.collection.transform");
+    kernels().affine_interleaved(lines.data(), lines.point_count(), op);
+}
+
+char const *line_kernel_isa() { return kernels().name; }
+
+bool set_line_kernel_isa(char const *name)
+{
+    LineKernelTable const *table = nullptr;
+    if (0 == std::strcmp(name, "scalar"))
+    {
+        table = &line_kernels_scalar();
+    }
+#if defined(__x86_64__) || defined(_M_X64)
+    else if (0 == std::strcmp(name, "sse2"))
+    {
+        table = &line_kernels_sse2();
+    }
+    else if (0 == std::strcmp(name, "avx2"))
+    {
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            table = &line_kernels_avx2();
+        }
+    }
+#endif
+#if defined(__aarch64__)
+    else if (0 == std::strcmp(name, "neon"))
+    {
+        table = &line_kernels_neon();
+    }
+#endif
+    if (!table)
+    {
+        return false;
+    }
+    active_kernels() = table;
+    return true;
+}
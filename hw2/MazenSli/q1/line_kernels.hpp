@@ -0,0 +1,64 @@
+#pragma once
+
+#include "line.hpp"
+#include "line_collection.hpp"
+
+/*
+ * Vectorized geometry kernels over lines.  Every kernel works on the x/y
+ * spans of a line, so it accepts Line, SoaLine, the allocator-aware lines and
+ * LineView alike.  The instruction set (AVX2, SSE2, NEON or scalar) is picked
+ * once at run time from what the CPU supports.
+ */
+
+struct BoundingBox
+{
+    float xmin, ymin, xmax, ymax;
+};
+
+struct Point
+{
+    float x, y;
+};
+
+/* x' = a * x + b * y + tx, y' = c * x + d * y + ty */
+struct Affine
+{
+    float a, b, c, d, tx, ty;
+
+    static Affine translation(float tx, float ty) { return {1, 0, 0, 1, tx, ty}; }
+    static Affine scaling(float sx, float sy) { return {sx, 0, 0, sy, 0, 0}; }
+    static Affine rotation(float radians); // counter-clockwise about the origin.
+};
+
+// Span-based kernels.  An empty line has an inverted (+inf/-inf) bounding box
+// and a NaN centroid.
+double length(StridedSpan<float const> xs, StridedSpan<float const> ys);
+BoundingBox bounding_box(StridedSpan<float const> xs, StridedSpan<float const> ys);
+Point centroid(StridedSpan<float const> xs, StridedSpan<float const> ys); // mean of the points.
+void transform(StridedSpan<float> xs, StridedSpan<float> ys, Affine const &op);
+
+// Line kernels.
+template <typename L>
+double length(L const &line) { return length(line.xs(), line.ys()); }
+template <typename L>
+BoundingBox bounding_box(L const &line) { return bounding_box(line.xs(), line.ys()); }
+template <typename L>
+Point centroid(L const &line) { return centroid(line.xs(), line.ys()); }
+template <typename L>
+void transform(L &line, Affine const &op) { transform(line.xs(), line.ys(), op); }
+template <typename L>
+void translate(L &line, float tx, float ty) { transform(line, Affine::translation(tx, ty)); }
+template <typename L>
+void scale(L &line, float sx, float sy) { transform(line, Affine::scaling(sx, sy)); }
+template <typename L>
+void rotate(L &line, float radians) { transform(line, Affine::rotation(radians)); }
+
+// Collection kernels.  These make one pass over the shared buffer.
+void lengths(LineCollection const &lines, double *out); // out has lines.size() entries.
+BoundingBox bounding_box(LineCollection const &lines);
+Point centroid(LineCollection const &lines);
+void transform(LineCollection &lines, Affine const &op);
+
+// Instruction set selection: "avx2", "sse2", "neon" or "scalar".
+char const *line_kernel_isa();
+bool set_line_kernel_isa(char const *name); // false if the CPU lacks it.
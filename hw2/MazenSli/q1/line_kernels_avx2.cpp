@@ -0,0 +1,44 @@
+/*
+ * AVX2 kernels.  This file alone is compiled with -mavx2 -mfma and is only
+ * called after the CPU check in line_kernels.cpp.
+ */
+
+#include "line_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+namespace
+{
+
+struct Avx2
+{
+    using reg = __m256;
+    using dreg = __m256d;
+    static constexpr size_t width = 8;
+
+    static reg load(float const *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg set1(float a) { return _mm256_set1_ps(a); }
+    static reg pairs(float a, float b) { return _mm256_setr_ps(a, b, a, b, a, b, a, b); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static reg sqrt(reg a) { return _mm256_sqrt_ps(a); }
+    static reg swap_pairs(reg a) { return _mm256_permute_ps(a, 0xB1); }
+
+    static dreg dzero() { return _mm256_setzero_pd(); }
+    static dreg dadd(dreg a, dreg b) { return _mm256_add_pd(a, b); }
+    static dreg cvt_lo(reg a) { return _mm256_cvtps_pd(_mm256_castps256_ps128(a)); }
+    static dreg cvt_hi(reg a) { return _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)); }
+    static void dstore(double *p, dreg v) { _mm256_storeu_pd(p, v); }
+}; /* end struct Avx2 */
+
+} /* end namespace */
+
+LineKernelTable const &line_kernels_avx2() { return SimdKernels<Avx2>::table("avx2"); }
+
+#endif
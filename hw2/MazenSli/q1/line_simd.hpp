@@ -0,0 +1,294 @@
+#pragma once
+
+/*
+ * Internals of line_kernels: the per-instruction-set kernel table and the
+ * kernels written once over a vector-traits type.  Each instruction set is
+ * instantiated in its own translation unit with traits in an anonymous
+ * namespace, so the instantiations never merge across compiler flags.  For
+ * the same reason the kernels only call C functions, not C++ inline ones.
+ */
+
+#include "line_kernels.hpp"
+
+#include <math.h> // plain C functions: no inline C++ code is shared across flags
+
+/* Primitive kernels on raw interleaved or planar coordinate arrays. */
+struct LineKernelTable
+{
+    char const *name;
+    void (*bounding_box_interleaved)(float const *coord, size_t npoint, BoundingBox *box);
+    void (*minmax)(float const *a, size_t n, float *lo, float *hi);
+    void (*sum_interleaved)(float const *coord, size_t npoint, double *sx, double *sy);
+    double (*sum)(float const *a, size_t n);
+    double (*length_interleaved)(float const *coord, size_t npoint);
+    double (*length_planar)(float const *x, float const *y, size_t npoint);
+    void (*affine_interleaved)(float *coord, size_t npoint, Affine const &op);
+    void (*affine_planar)(float *x, float *y, size_t npoint, Affine const &op);
+};
+
+LineKernelTable const &line_kernels_scalar();
+#if defined(__x86_64__) || defined(_M_X64)
+LineKernelTable const &line_kernels_sse2();
+LineKernelTable const &line_kernels_avx2();
+#endif
+#if defined(__aarch64__)
+LineKernelTable const &line_kernels_neon();
+#endif
+
+/*
+ * Kernels over a traits type V providing a float register V::reg of V::width
+ * lanes (even), and a double register V::dreg of V::width / 2 lanes.  Loop
+ * tails fall back to scalar code.  Interleaved loops rely on an even width:
+ * lane k of every register then always holds x for even k and y for odd k.
+ */
+template <typename V>
+struct SimdKernels
+{
+    using reg = typename V::reg;
+    using dreg = typename V::dreg;
+    static constexpr size_t W = V::width;
+    static constexpr size_t DW = W / 2;
+
+    /* Lane-wise min/max over a[0, m); returns the first index not covered. */
+    static size_t minmax_lanes(float const *a, size_t m, float *lo, float *hi)
+    {
+        // Two accumulators each to hide the min/max latency.
+        reg lo0 = V::set1(HUGE_VALF), lo1 = lo0;
+        reg hi0 = V::set1(-HUGE_VALF), hi1 = hi0;
+        size_t it = 0;
+        for (; it + 2 * W <= m; it += 2 * W)
+        {
+            reg v0 = V::load(a + it);
+            reg v1 = V::load(a + it + W);
+            lo0 = V::min(lo0, v0);
+            hi0 = V::max(hi0, v0);
+            lo1 = V::min(lo1, v1);
+            hi1 = V::max(hi1, v1);
+        }
+        for (; it + W <= m; it += W)
+        {
+            reg v = V::load(a + it);
+            lo0 = V::min(lo0, v);
+            hi0 = V::max(hi0, v);
+        }
+        V::store(lo, V::min(lo0, lo1));
+        V::store(hi, V::max(hi0, hi1));
+        return it;
+    }
+
+    /* Lane-wise double sums of a[0, m); returns the first index not covered. */
+    static size_t sum_lanes(float const *a, size_t m, double *lanes)
+    {
+        dreg acc_lo = V::dzero();
+        dreg acc_hi = V::dzero();
+        size_t it = 0;
+        for (; it + W <= m; it += W)
+        {
+            reg v = V::load(a + it);
+            acc_lo = V::dadd(acc_lo, V::cvt_lo(v));
+            acc_hi = V::dadd(acc_hi, V::cvt_hi(v));
+        }
+        V::dstore(lanes, acc_lo);
+        V::dstore(lanes + DW, acc_hi);
+        return it;
+    }
+
+    static void bounding_box_interleaved(float const *coord, size_t npoint, BoundingBox *box)
+    {
+        size_t m = 2 * npoint;
+        float lo[W], hi[W];
+        size_t it = minmax_lanes(coord, m, lo, hi);
+        float xlo = lo[0], ylo = lo[1], xhi = hi[0], yhi = hi[1];
+        for (size_t k = 2; k < W; k += 2)
+        {
+            xlo = lo[k] < xlo ? lo[k] : xlo;
+            ylo = lo[k + 1] < ylo ? lo[k + 1] : ylo;
+            xhi = hi[k] > xhi ? hi[k] : xhi;
+            yhi = hi[k + 1] > yhi ? hi[k + 1] : yhi;
+        }
+        for (; it < m; it += 2)
+        {
+            xlo = coord[it] < xlo ? coord[it] : xlo;
+            ylo = coord[it + 1] < ylo ? coord[it + 1] : ylo;
+            xhi = coord[it] > xhi ? coord[it] : xhi;
+            yhi = coord[it + 1] > yhi ? coord[it + 1] : yhi;
+        }
+        *box = {xlo, ylo, xhi, yhi};
+    }
+
+    static void minmax(float const *a, size_t n, float *plo, float *phi)
+    {
+        float lo[W], hi[W];
+        size_t it = minmax_lanes(a, n, lo, hi);
+        float vlo = lo[0], vhi = hi[0];
+        for (size_t k = 1; k < W; ++k)
+        {
+            vlo = lo[k] < vlo ? lo[k] : vlo;
+            vhi = hi[k] > vhi ? hi[k] : vhi;
+        }
+        for (; it < n; ++it)
+        {
+            vlo = a[it] < vlo ? a[it] : vlo;
+            vhi = a[it] > vhi ? a[it] : vhi;
+        }
+        *plo = vlo;
+        *phi = vhi;
+    }
+
+    static void sum_interleaved(float const *coord, size_t npoint, double *sx, double *sy)
+    {
+        size_t m = 2 * npoint;
+        double lanes[W];
+        size_t it = sum_lanes(coord, m, lanes);
+        double x = 0, y = 0;
+        for (size_t k = 0; k < W; k += 2)
+        {
+            x += lanes[k];
+            y += lanes[k + 1];
+        }
+        for (; it < m; it += 2)
+        {
+            x += coord[it];
+            y += coord[it + 1];
+        }
+        *sx = x;
+        *sy = y;
+    }
+
+    static double sum(float const *a, size_t n)
+    {
+        double lanes[W];
+        size_t it = sum_lanes(a, n, lanes);
+        double ret = 0;
+        for (size_t k = 0; k < W; ++k)
+        {
+            ret += lanes[k];
+        }
+        for (; it < n; ++it)
+        {
+            ret += a[it];
+        }
+        return ret;
+    }
+
+    static double length_interleaved(float const *coord, size_t npoint)
+    {
+        size_t nseg = npoint ? npoint - 1 : 0;
+        dreg acc_lo = V::dzero();
+        dreg acc_hi = V::dzero();
+        size_t it = 0;
+        // W / 2 segments per register; dx^2 + dy^2 lands in both lanes of a
+        // point, so every segment is summed twice.
+        for (; it + DW <= nseg; it += DW)
+        {
+            reg d = V::sub(V::load(coord + 2 * it + 2), V::load(coord + 2 * it));
+            reg sq = V::mul(d, d);
+            reg r = V::sqrt(V::add(sq, V::swap_pairs(sq)));
+            acc_lo = V::dadd(acc_lo, V::cvt_lo(r));
+            acc_hi = V::dadd(acc_hi, V::cvt_hi(r));
+        }
+        double lanes[W];
+        V::dstore(lanes, acc_lo);
+        V::dstore(lanes + DW, acc_hi);
+        double ret = 0;
+        for (size_t k = 0; k < W; ++k)
+        {
+            ret += lanes[k];
+        }
+        ret *= 0.5;
+        for (; it < nseg; ++it)
+        {
+            float dx = coord[2 * it + 2] - coord[2 * it];
+            float dy = coord[2 * it + 3] - coord[2 * it + 1];
+            ret += sqrtf(dx * dx + dy * dy);
+        }
+        return ret;
+    }
+
+    static double length_planar(float const *x, float const *y, size_t npoint)
+    {
+        size_t nseg = npoint ? npoint - 1 : 0;
+        dreg acc_lo = V::dzero();
+        dreg acc_hi = V::dzero();
+        size_t it = 0;
+        for (; it + W <= nseg; it += W)
+        {
+            reg dx = V::sub(V::load(x + it + 1), V::load(x + it));
+            reg dy = V::sub(V::load(y + it + 1), V::load(y + it));
+            reg r = V::sqrt(V::add(V::mul(dx, dx), V::mul(dy, dy)));
+            acc_lo = V::dadd(acc_lo, V::cvt_lo(r));
+            acc_hi = V::dadd(acc_hi, V::cvt_hi(r));
+        }
+        double lanes[W];
+        V::dstore(lanes, acc_lo);
+        V::dstore(lanes + DW, acc_hi);
+        double ret = 0;
+        for (size_t k = 0; k < W; ++k)
+        {
+            ret += lanes[k];
+        }
+        for (; it < nseg; ++it)
+        {
+            float dx = x[it + 1] - x[it];
+            float dy = y[it + 1] - y[it];
+            ret += sqrtf(dx * dx + dy * dy);
+        }
+        return ret;
+    }
+
+    static void affine_interleaved(float *coord, size_t npoint, Affine const &op)
+    {
+        size_t m = 2 * npoint;
+        reg ad = V::pairs(op.a, op.d);
+        reg bc = V::pairs(op.b, op.c);
+        reg t = V::pairs(op.tx, op.ty);
+        size_t it = 0;
+        for (; it + W <= m; it += W)
+        {
+            reg v = V::load(coord + it);
+            V::store(coord + it, V::add(V::add(V::mul(v, ad), V::mul(V::swap_pairs(v), bc)), t));
+        }
+        for (; it < m; it += 2)
+        {
+            float x = coord[it], y = coord[it + 1];
+            coord[it] = x * op.a + y * op.b + op.tx;
+            coord[it + 1] = y * op.d + x * op.c + op.ty;
+        }
+    }
+
+    static void affine_planar(float *x, float *y, size_t npoint, Affine const &op)
+    {
+        reg a = V::set1(op.a), b = V::set1(op.b), c = V::set1(op.c), d = V::set1(op.d);
+        reg tx = V::set1(op.tx), ty = V::set1(op.ty);
+        size_t it = 0;
+        for (; it + W <= npoint; it += W)
+        {
+            reg vx = V::load(x + it);
+            reg vy = V::load(y + it);
+            V::store(x + it, V::add(V::add(V::mul(vx, a), V::mul(vy, b)), tx));
+            V::store(y + it, V::add(V::add(V::mul(vy, d), V::mul(vx, c)), ty));
+        }
+        for (; it < npoint; ++it)
+        {
+            float vx = x[it], vy = y[it];
+            x[it] = vx * op.a + vy * op.b + op.tx;
+            y[it] = vy * op.d + vx * op.c + op.ty;
+        }
+    }
+
+    static LineKernelTable const &table(char const *name)
+    {
+        static LineKernelTable const ret{
+            name,
+            &bounding_box_interleaved,
+            &minmax,
+            &sum_interleaved,
+            &sum,
+            &length_interleaved,
+            &length_planar,
+            &affine_interleaved,
+            &affine_planar,
+        };
+        return ret;
+    }
+}; /* end struct SimdKernels */
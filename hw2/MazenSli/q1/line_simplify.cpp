@@ -0,0 +1,317 @@
+#include "line_simplify.hpp"
+
+#include <cmath>
+#include <exception>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+
+/* Below this many points a Douglas-Peucker range is not split across threads */
+size_t const parallel_grain = 1 << 14;
+
+struct DouglasPeucker
+{
+    StridedSpan<float const> xs;
+    StridedSpan<float const> ys;
+    float tolerance2;
+    SimplifyWorkspace &ws;
+
+    /* Squared distance from point it to the segment (first, last) */
+    float distance2(size_t it, size_t first, size_t last) const
+    {
+        float ax = xs[first], ay = ys[first];
+        float dx = xs[last] - ax, dy = ys[last] - ay;
+        float px = xs[it] - ax, py = ys[it] - ay;
+        float len2 = dx * dx + dy * dy;
+        if (len2 > 0)
+        {
+            float t = std::min(std::max((px * dx + py * dy) / len2, 0.f), 1.f);
+            px -= t * dx;
+            py -= t * dy;
+        }
+        return px * px + py * py;
+    }
+
+    /* The farthest interior point of (first, last), or 0 if within tolerance */
+    size_t split(size_t first, size_t last) const
+    {
+        size_t ret = 0;
+        float best = tolerance2;
+        for (size_t it = first + 1; it < last; ++it)
+        {
+            float d2 = distance2(it, first, last);
+            if (d2 > best)
+            {
+                best = d2;
+                ret = it;
+            }
+        }
+        return ret;
+    }
+
+    void serial(size_t first, size_t last, std::vector<std::pair<size_t, size_t>> &stack) const
+    {
+        stack.clear();
+        stack.emplace_back(first, last);
+        while (!stack.empty())
+        {
+            std::pair<size_t, size_t> range = stack.back();
+            stack.pop_back();
+            if (range.second - range.first < 2)
+            {
+                continue;
+            }
+            size_t mid = split(range.first, range.second);
+            if (mid)
+            {
+                ws.keep[mid] = 1;
+                stack.emplace_back(range.first, mid);
+                stack.emplace_back(mid, range.second);
+            }
+        }
+    }
+
+    /*
+     * Split on up to 2^depth threads.  Task id spawns id + 2^(depth-1), so
+     * the leaves use distinct stacks in [0, 2^depth).  A side shorter than
+     * parallel_grain is finished here instead of getting a thread, and the
+     * other side carries on with the same depth.
+     */
+    void parallel(size_t first, size_t last, size_t id, unsigned depth) const
+    {
+        while (depth > 0 && last - first >= parallel_grain)
+        {
+            size_t mid = split(first, last);
+            if (!mid)
+            {
+                return;
+            }
+            // keep is a char array, so the threads write disjoint memory.
+            ws.keep[mid] = 1;
+            if (mid - first < parallel_grain)
+            {
+                serial(first, mid, ws.stacks[id]);
+                first = mid;
+            }
+            else if (last - mid < parallel_grain)
+            {
+                serial(mid, last, ws.stacks[id]);
+                last = mid;
+            }
+            else
+            {
+                fork(first, mid, last, id, depth);
+                return;
+            }
+        }
+        serial(first, last, ws.stacks[id]);
+    }
+
+    /* Left half on a new thread, right half here; rethrows either one's error */
+    void fork(size_t first, size_t mid, size_t last, size_t id, unsigned depth) const
+    {
+        size_t child = id + (size_t(1) << (depth - 1));
+        std::exception_ptr error;
+        std::thread left;
+        try
+        {
+            left = std::thread([=, &error] {
+                try
+                {
+                    parallel(first, mid, child, depth - 1);
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            });
+        }
+        catch (std::system_error const &)
+        {
+            parallel(first, mid, child, depth - 1); // out of threads.
+        }
+        // Joins when the right half throws, too.
+        struct Joiner
+        {
+            std::thread &thread;
+            ~Joiner()
+            {
+                if (thread.joinable())
+                {
+                    thread.join();
+                }
+            }
+        } joiner{left};
+        parallel(mid, last, id, depth - 1);
+        left.join();
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}; /* end struct DouglasPeucker */
+
+/* Twice the unsigned area of the triangle (a, b, c) */
+float double_area(StridedSpan<float const> xs, StridedSpan<float const> ys, size_t a, size_t b, size_t c)
+{
+    return std::fabs((xs[b] - xs[a]) * (ys[c] - ys[a]) - (xs[c] - xs[a]) * (ys[b] - ys[a]));
+}
+
+/* Indexed min-heap of vertex ids keyed on ws.area */
+struct AreaHeap
+{
+    SimplifyWorkspace &ws;
+
+    bool less(size_t i, size_t j) const { return ws.area[ws.heap[i]] < ws.area[ws.heap[j]]; }
+
+    void swap(size_t i, size_t j)
+    {
+        std::swap(ws.heap[i], ws.heap[j]);
+        ws.pos[ws.heap[i]] = i;
+        ws.pos[ws.heap[j]] = j;
+    }
+
+    void sift_up(size_t i)
+    {
+        while (i > 0 && less(i, (i - 1) / 2))
+        {
+            swap(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(size_t i)
+    {
+        for (;;)
+        {
+            size_t smallest = i;
+            size_t left = 2 * i + 1, right = 2 * i + 2;
+            if (left < ws.heap.size() && less(left, smallest))
+            {
+                smallest = left;
+            }
+            if (right < ws.heap.size() && less(right, smallest))
+            {
+                smallest = right;
+            }
+            if (smallest == i)
+            {
+                return;
+            }
+            swap(i, smallest);
+            i = smallest;
+        }
+    }
+
+    void pop()
+    {
+        swap(0, ws.heap.size() - 1);
+        ws.heap.pop_back();
+        if (!ws.heap.empty())
+        {
+            sift_down(0);
+        }
+    }
+
+    void update(size_t vertex)
+    {
+        sift_up(ws.pos[vertex]);
+        sift_down(ws.pos[vertex]);
+    }
+}; /* end struct AreaHeap */
+
+} /* end namespace */
+
+void douglas_peucker_mask(StridedSpan<float const> xs, StridedSpan<float const> ys,
+                          float tolerance, SimplifyWorkspace &ws, unsigned nthread)
+{
+    INSTRUMENT_TIME("line_simplify.douglas_peucker");
+    size_t npoint = xs.size();
+    ws.keep.assign(npoint, 0);
+    if (0 == npoint)
+    {
+        return;
+    }
+    ws.keep.front() = ws.keep.back() = 1;
+
+    if (0 == nthread)
+    {
+        nthread = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    unsigned depth = 0;
+    while ((1u << depth) < nthread)
+    {
+        ++depth;
+    }
+    if (ws.stacks.size() < (size_t(1) << depth))
+    {
+        ws.stacks.resize(size_t(1) << depth);
+    }
+
+    DouglasPeucker dp{xs, ys, tolerance * tolerance, ws};
+    dp.parallel(0, npoint - 1, 0, depth);
+}
+
+void visvalingam_mask(StridedSpan<float const> xs, StridedSpan<float const> ys,
+                      float min_area, SimplifyWorkspace &ws)
+{
+    INSTRUMENT_TIME("line_simplify.visvalingam");
+    size_t npoint = xs.size();
+    ws.keep.assign(npoint, 1);
+    if (npoint < 3)
+    {
+        return;
+    }
+
+    ws.prev.resize(npoint);
+    ws.next.resize(npoint);
+    ws.area.resize(npoint);
+    ws.pos.resize(npoint);
+    ws.heap.clear();
+    for (size_t it = 0; it < npoint; ++it)
+    {
+        ws.prev[it] = it - 1;
+        ws.next[it] = it + 1;
+    }
+    // Areas are compared doubled, so compare against a doubled threshold.
+    float threshold = 2 * min_area;
+    AreaHeap heap{ws};
+    for (size_t it = 1; it + 1 < npoint; ++it)
+    {
+        ws.area[it] = double_area(xs, ys, it - 1, it, it + 1);
+        ws.pos[it] = ws.heap.size();
+        ws.heap.push_back(it);
+        heap.sift_up(ws.pos[it]);
+    }
+
+    while (!ws.heap.empty() && ws.area[ws.heap.front()] < threshold)
+    {
+        size_t vertex = ws.heap.front();
+        float removed = ws.area[vertex];
+        heap.pop();
+        ws.keep[vertex] = 0;
+        size_t before = ws.prev[vertex], after = ws.next[vertex];
+        ws.next[before] = after;
+        ws.prev[after] = before;
+        // A neighbour never gets a smaller area than the point just removed,
+        // so points are removed in non-decreasing order of effective area.
+        for (size_t neighbour : {before, after})
+        {
+            if (0 == neighbour || npoint - 1 == neighbour)
+            {
+                continue;
+            }
+            float a = double_area(xs, ys, ws.prev[neighbour], neighbour, ws.next[neighbour]);
+            ws.area[neighbour] = std::max(a, removed);
+            heap.update(neighbour);
+        }
+    }
+}
+
+SimplifyWorkspace &thread_simplify_workspace()
+{
+    thread_local SimplifyWorkspace ws;
+    return ws;
+}
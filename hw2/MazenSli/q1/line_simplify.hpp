@@ -0,0 +1,87 @@
+#pragma once
+
+#include "line.hpp"
+
+/*
+ * Polyline simplification.  Both algorithms always keep the end points and
+ * write the kept points into a caller-provided output line, which is cleared
+ * but keeps its capacity.  The scratch arrays live in a SimplifyWorkspace, so
+ * once the workspace and the output are warm nothing is allocated per call.
+ * The output must not be the input.
+ */
+
+/* Scratch space reused across calls; the members are internal. */
+struct SimplifyWorkspace
+{
+    std::vector<char> keep;
+    // Douglas-Peucker: one explicit split stack per parallel task.
+    std::vector<std::vector<std::pair<size_t, size_t>>> stacks;
+    // Visvalingam: doubly-linked vertex list and an indexed min-heap on area.
+    std::vector<size_t> prev, next, heap, pos;
+    std::vector<float> area;
+};
+
+/*
+ * Mark the points Douglas-Peucker keeps in ws.keep: a point survives when
+ * it is farther than tolerance from the segment joining the kept points
+ * around it.  The recursive split runs on up to nthread threads (0 means
+ * one per hardware thread).
+ */
+void douglas_peucker_mask(StridedSpan<float const> xs, StridedSpan<float const> ys,
+                          float tolerance, SimplifyWorkspace &ws, unsigned nthread = 1);
+
+/*
+ * Mark the points Visvalingam-Whyatt keeps in ws.keep: the point with the
+ * smallest effective area (the triangle with its neighbours) is removed
+ * repeatedly while that area is below min_area.
+ */
+void visvalingam_mask(StridedSpan<float const> xs, StridedSpan<float const> ys,
+                      float min_area, SimplifyWorkspace &ws);
+
+template <typename In, typename Out>
+void copy_kept_points(In const &in, Out &out, std::vector<char> const &keep)
+{
+    if (static_cast<void const *>(&in) == static_cast<void const *>(&out))
+    {
+        throw std::invalid_argument("simplify: output must not be the input");
+    }
+    StridedSpan<float const> xs = in.xs();
+    StridedSpan<float const> ys = in.ys();
+    out.clear();
+    for (size_t it = 0; it < xs.size(); ++it)
+    {
+        if (keep[it])
+        {
+            out.push_back(xs[it], ys[it]);
+        }
+    }
+}
+
+template <typename In, typename Out>
+void simplify_douglas_peucker(In const &in, Out &out, float tolerance, SimplifyWorkspace &ws, unsigned nthread = 1)
+{
+    douglas_peucker_mask(in.xs(), in.ys(), tolerance, ws, nthread);
+    copy_kept_points(in, out, ws.keep);
+}
+
+template <typename In, typename Out>
+void simplify_visvalingam(In const &in, Out &out, float min_area, SimplifyWorkspace &ws)
+{
+    visvalingam_mask(in.xs(), in.ys(), min_area, ws);
+    copy_kept_points(in, out, ws.keep);
+}
+
+// Overloads with a per-thread workspace.
+SimplifyWorkspace &thread_simplify_workspace();
+
+template <typename In, typename Out>
+void simplify_douglas_peucker(In const &in, Out &out, float tolerance, unsigned nthread = 1)
+{
+    simplify_douglas_peucker(in, out, tolerance, thread_simplify_workspace(), nthread);
+}
+
+template <typename In, typename Out>
+void simplify_visvalingam(In const &in, Out &out, float min_area)
+{
+    simplify_visvalingam(in, out, min_area, thread_simplify_workspace());
+}
@@ -0,0 +1,765 @@
+/*
+ * Checks for the line library, run by make check.  Every failed expectation
+ * is printed; the exit status is nonzero if any failed.
+ */
+#include "instrument.hpp"
+#include "line.hpp"
+#include "line_alloc.hpp"
+#include "line_collection.hpp"
+#include "line_io.hpp"
+#include "line_kernels.hpp"
+#include "line_simplify.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace
+{
+
+int failures = 0;
+
+#define EXPECT(cond)                                                                                                   \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #cond);                                   \
+            ++failures;                                                                                                \
+        }                                                                                                              \
+    } while (0)
+
+template <typename E, typename F>
+bool throws(F fn)
+{
+    try
+    {
+        fn();
+    }
+    catch (E const &)
+    {
+        return true;
+    }
+    return false;
+}
+
+template <typename A, typename B>
+bool same_points(A const &a, B const &b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t it = 0; it < a.size(); ++it)
+    {
+        if (a.x(it) != b.x(it) || a.y(it) != b.y(it))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Line make_line(std::vector<std::pair<float, float>> const &points)
+{
+    Line ret(points.size());
+    for (size_t it = 0; it < points.size(); ++it)
+    {
+        ret.x(it) = points[it].first;
+        ret.y(it) = points[it].second;
+    }
+    return ret;
+}
+
+/* A long wiggly line, far above the threaded split threshold */
+Line make_wave(size_t npoint)
+{
+    Line ret(npoint);
+    for (size_t it = 0; it < npoint; ++it)
+    {
+        ret.x(it) = 0.01f * it;
+        ret.y(it) = std::sin(0.001f * it) * 100 + std::sin(0.37f * it);
+    }
+    return ret;
+}
+
+/* A scratch file removed when it goes out of scope */
+struct TempFile
+{
+    TempFile() : path("/tmp/line_test.XXXXXX")
+    {
+        int fd = ::mkstemp(&path[0]);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot create a temporary file");
+        }
+        ::close(fd);
+    }
+    ~TempFile() { ::unlink(path.c_str()); }
+
+    std::vector<char> read() const
+    {
+        std::ifstream in(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    }
+    void write(std::vector<char> const &bytes) const
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size());
+    }
+
+    std::string path;
+}; /* end struct TempFile */
+
+/* Rewrite the header of a line file through fn(header) */
+template <typename F>
+void patch_header(TempFile const &file, F fn)
+{
+    std::vector<char> bytes = file.read();
+    LineFileHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    fn(header);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    file.write(bytes);
+}
+
+bool rejected(TempFile const &file)
+{
+    return throws<std::runtime_error>([&] { MappedLines mapped(file.path); });
+}
+
+void test_line_assign()
+{
+    Line small = make_line({{1, 2}, {3, 4}});
+    Line large = make_wave(100);
+
+    // Growing: the destination takes every point of the larger line.
+    Line dst = small;
+    dst = large;
+    EXPECT(same_points(dst, large));
+    EXPECT(same_points(small, make_line({{1, 2}, {3, 4}})));
+
+    // Shrinking keeps the destination's buffer and drops the tail.
+    float const *buffer = dst.data();
+    size_t capacity = dst.capacity();
+    dst = small;
+    EXPECT(same_points(dst, small));
+    EXPECT(buffer == dst.data() && capacity == dst.capacity());
+    dst = large;
+    EXPECT(same_points(dst, large));
+    EXPECT(buffer == dst.data());
+
+    Line &alias = dst;
+    dst = alias;
+    EXPECT(same_points(dst, large));
+    dst = std::move(alias);
+    EXPECT(same_points(dst, large));
+
+    // Moving swaps the buffers; the source stays usable.
+    Line src = small;
+    dst = std::move(src);
+    EXPECT(same_points(dst, small));
+    src = small;
+    EXPECT(same_points(src, small));
+}
+
+void test_line_capacity()
+{
+    Line line;
+    EXPECT(0 == line.size());
+    line.reserve(64);
+    EXPECT(line.capacity() >= 64 && 0 == line.size());
+    float const *buffer = line.data();
+    for (size_t it = 0; it < 64; ++it)
+    {
+        line.push_back(it, -float(it));
+    }
+    EXPECT(64 == line.size() && buffer == line.data());
+    EXPECT(63 == line.x(63) && -63 == line.y(63));
+
+    // resize() keeps the leading points and zero-fills the new ones.
+    line.resize(10);
+    EXPECT(10 == line.size() && buffer == line.data());
+    EXPECT(9 == line.x(9) && -9 == line.y(9));
+    line.resize(12);
+    EXPECT(12 == line.size() && 0 == line.x(11) && 0 == line.y(11));
+    EXPECT(buffer == line.data());
+
+    line.clear();
+    EXPECT(0 == line.size() && line.capacity() >= 64);
+    line.shrink_to_fit();
+    EXPECT(0 == line.capacity());
+    line.push_back(1, 2);
+    EXPECT(same_points(line, make_line({{1, 2}})));
+}
+
+void test_arena()
+{
+    LineArena arena(4096);
+    float const *first;
+    {
+        ArenaLine line(100, ArenaAllocator<float>(arena));
+        first = line.data();
+        ArenaLine other(100, ArenaAllocator<float>(arena));
+        EXPECT(other.data() != first);
+    }
+    EXPECT(1 == arena.chunk_count() && 4096 == arena.bytes_reserved());
+
+    // After reset() the same chunk hands out the same addresses again.
+    arena.reset();
+    {
+        ArenaLine line(100, ArenaAllocator<float>(arena));
+        EXPECT(first == line.data());
+    }
+    EXPECT(1 == arena.chunk_count());
+
+    // A request larger than a chunk gets a chunk of its own.
+    arena.reset();
+    {
+        ArenaLine line(2000, ArenaAllocator<float>(arena));
+        EXPECT(2 == arena.chunk_count() && 4096 + 16000 == arena.bytes_reserved());
+    }
+    EXPECT(throws<std::bad_alloc>([&] { arena.allocate(8, 2 * alignof(std::max_align_t)); }));
+}
+
+void test_pool()
+{
+    LinePool pool(2 * 16 * sizeof(float), 2);
+    PoolAllocator<float> alloc(pool);
+    float const *first;
+    {
+        PoolLine line(16, alloc);
+        first = line.data();
+    }
+    // A freed block is the next one handed out.
+    {
+        PoolLine line(alloc);
+        line.reserve(16);
+        EXPECT(first == line.data());
+        PoolLine second(16, alloc), third(16, alloc);
+        EXPECT(second.data() != first && third.data() != first && second.data() != third.data());
+        EXPECT(2 == pool.chunk_count());
+    }
+    EXPECT(throws<std::bad_alloc>([&] { PoolLine line(17, alloc); }));
+
+    pool.reset();
+    {
+        PoolLine line(8, alloc);
+        EXPECT(first == line.data());
+    }
+    EXPECT(2 == pool.chunk_count());
+}
+
+void test_arena_line_assign()
+{
+    LineArena arena1, arena2;
+    ArenaAllocator<float> alloc1(arena1), alloc2(arena2);
+    ArenaLine src(alloc1), dst(alloc2);
+    src.push_back(1, 2);
+    src.push_back(3, 4);
+
+    // Copy assignment keeps the destination's arena.
+    dst = src;
+    EXPECT(same_points(dst, src));
+    EXPECT(&arena2 == dst.get_allocator().resource());
+    ArenaLine copy(src);
+    EXPECT(&arena1 == copy.get_allocator().resource());
+
+    // Move assignment takes the source's arena along with its buffer.
+    float const *buffer = src.data();
+    dst = std::move(src);
+    EXPECT(&arena1 == dst.get_allocator().resource() && buffer == dst.data());
+    EXPECT(same_points(dst, copy));
+    ArenaLine moved(std::move(dst));
+    EXPECT(&arena1 == moved.get_allocator().resource() && buffer == moved.data());
+}
+
+/* The buffer of a copy-on-write line, read without detaching it */
+float const *shared_data(CowLine const &line) { return line.data(); }
+
+void test_cow_line()
+{
+    CowLine original(3);
+    for (size_t it = 0; it < 3; ++it)
+    {
+        original.x(it) = it;
+        original.y(it) = 10 + it;
+    }
+    float const *buffer = shared_data(original);
+
+    // A copy shares the buffer until it is written through.
+    CowLine copy = original;
+    EXPECT(buffer == shared_data(copy) && same_points(copy, original));
+    CowLine assigned;
+    assigned = original;
+    EXPECT(buffer == shared_data(assigned));
+
+    // The write detaches the writer only; the others keep the old buffer.
+    // Reads go through const references, as a non-const x() would detach.
+    copy.x(0) = 100;
+    EXPECT(buffer != shared_data(copy) && 100 == shared_data(copy)[0]);
+    EXPECT(buffer == shared_data(original) && buffer == shared_data(assigned));
+    EXPECT(0 == std::as_const(original).x(0) && 0 == std::as_const(assigned).x(0));
+    assigned.push_back(3, 13);
+    EXPECT(4 == assigned.size() && 3 == original.size());
+
+    // The last owner writes in place.
+    original.y(2) = -1;
+    EXPECT(buffer == shared_data(original) && -1 == std::as_const(original).y(2));
+
+    // A moved-from line is empty and usable, and the target keeps the buffer.
+    CowLine moved(std::move(original));
+    EXPECT(buffer == shared_data(moved) && 0 == original.size());
+    original.push_back(1, 2);
+    EXPECT(1 == original.size() && 3 == moved.size());
+    moved = std::move(copy);
+    EXPECT(100 == std::as_const(moved).x(0) && 3 == copy.size() && buffer == shared_data(copy));
+    copy.x(1) = 5;
+    EXPECT(100 == std::as_const(moved).x(0) && 1 == std::as_const(moved).x(1));
+}
+
+/* Equal within a relative tolerance, or both NaN */
+bool near(double a, double b, double tolerance = 1e-5)
+{
+    if (std::isnan(a) || std::isnan(b))
+    {
+        return std::isnan(a) && std::isnan(b);
+    }
+    return std::fabs(a - b) <= tolerance * std::max(1.0, std::fabs(b));
+}
+
+template <typename A, typename B>
+bool near_points(A const &a, B const &b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t it = 0; it < a.size(); ++it)
+    {
+        if (!near(a.x(it), b.x(it)) || !near(a.y(it), b.y(it)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Every kernel on the interleaved and the planar layout against the scalar path */
+template <typename L>
+void check_kernels_against_scalar(char const *isa, L const &line)
+{
+    Affine op = Affine::rotation(0.3f);
+    op.tx = 2;
+    op.ty = -1;
+
+    set_line_kernel_isa("scalar");
+    double length_ref = length(line);
+    BoundingBox box_ref = bounding_box(line);
+    Point centroid_ref = centroid(line);
+    L moved_ref = line;
+    transform(moved_ref, op);
+
+    set_line_kernel_isa(isa);
+    EXPECT(near(length(line), length_ref));
+    BoundingBox box = bounding_box(line);
+    EXPECT(box.xmin == box_ref.xmin && box.ymin == box_ref.ymin);
+    EXPECT(box.xmax == box_ref.xmax && box.ymax == box_ref.ymax);
+    Point point = centroid(line);
+    EXPECT(near(point.x, centroid_ref.x) && near(point.y, centroid_ref.y));
+    L moved = line;
+    transform(moved, op);
+    EXPECT(near_points(moved, moved_ref));
+}
+
+void test_soa_line()
+{
+    Line aos = make_wave(50);
+    SoaLine soa(aos.size());
+    for (size_t it = 0; it < aos.size(); ++it)
+    {
+        soa.x(it) = aos.x(it);
+        soa.y(it) = aos.y(it);
+    }
+    EXPECT(50 == soa.size() && same_points(soa, aos));
+
+    // Planar spans have stride 1; the interleaved ones step over the other axis.
+    SoaLine const &csoa = soa;
+    EXPECT(soa.xs().contiguous() && soa.ys().contiguous());
+    EXPECT(50 == csoa.xs().size() && &csoa.x(0) == csoa.xs().data() && &csoa.y(0) == csoa.ys().data());
+    EXPECT(2 == aos.xs().stride() && aos.data() + 1 == aos.ys().data());
+    for (size_t it = 0; it < aos.size(); ++it)
+    {
+        EXPECT(csoa.xs()[it] == aos.xs()[it] && csoa.ys()[it] == aos.ys()[it]);
+    }
+    soa.xs()[3] = 7;
+    EXPECT(7 == soa.x(3));
+    soa.x(3) = aos.x(3);
+
+    // The kernels and the simplifiers give the same answers on either layout.
+    EXPECT(near(length(soa), length(aos)));
+    BoundingBox box = bounding_box(soa), box_aos = bounding_box(aos);
+    EXPECT(box.xmin == box_aos.xmin && box.ymax == box_aos.ymax);
+    Point point = centroid(soa), point_aos = centroid(aos);
+    EXPECT(near(point.x, point_aos.x) && near(point.y, point_aos.y));
+    Line out, out_aos;
+    simplify_douglas_peucker(soa, out, 0.5f, 1);
+    simplify_douglas_peucker(aos, out_aos, 0.5f, 1);
+    EXPECT(same_points(out, out_aos));
+    simplify_visvalingam(soa, out, 0.5f);
+    simplify_visvalingam(aos, out_aos, 0.5f);
+    EXPECT(same_points(out, out_aos));
+
+    SoaLine copy = soa;
+    copy.push_back(1, 2);
+    EXPECT(51 == copy.size() && 50 == soa.size() && 2 == copy.y(50));
+    copy.resize(2);
+    EXPECT(same_points(copy, make_line({{aos.x(0), aos.y(0)}, {aos.x(1), aos.y(1)}})));
+#ifndef NDEBUG
+    EXPECT(throws<std::out_of_range>([&] { copy.x(2); }));
+#endif
+}
+
+void test_kernel_isas()
+{
+    char const *saved = line_kernel_isa();
+    for (char const *isa : {"scalar", "sse2", "avx2", "neon"})
+    {
+        if (!set_line_kernel_isa(isa))
+        {
+            continue;
+        }
+        EXPECT(0 == std::strcmp(isa, line_kernel_isa()));
+        // Every remainder of the vector widths, empty lines included.
+        for (size_t npoint = 0; npoint <= 33; ++npoint)
+        {
+            Line line = make_wave(npoint);
+            SoaLine soa(npoint);
+            for (size_t it = 0; it < npoint; ++it)
+            {
+                soa.x(it) = line.x(it) - 3;
+                soa.y(it) = -line.y(it);
+            }
+            check_kernels_against_scalar(isa, line);
+            check_kernels_against_scalar(isa, soa);
+        }
+    }
+    EXPECT(!set_line_kernel_isa("mmx"));
+    set_line_kernel_isa(saved);
+}
+
+void test_io_round_trip()
+{
+    LineCollection lines;
+    lines.append(make_line({{0, 1}, {2, 3}, {4, 5}}));
+    lines.append(0);
+    lines.append(make_line({{-1, 7.5f}}));
+
+    TempFile file;
+    write_lines(file.path, lines);
+    MappedLines mapped(file.path);
+    EXPECT(3 == mapped.size());
+    EXPECT(4 == mapped.point_count());
+    for (size_t it = 0; it < lines.size(); ++it)
+    {
+        EXPECT(lines.line_size(it) == mapped.line_size(it));
+        EXPECT(same_points(lines[it], mapped[it]));
+        EXPECT(same_points(lines.line(it), mapped.line(it)));
+    }
+    LineCollection copy = mapped.collection();
+    EXPECT(3 == copy.size() && 0 == copy.line_size(1));
+    EXPECT(throws<std::out_of_range>([&] { mapped.at(3); }));
+
+    // Moving hands the mapping over.
+    MappedLines moved(std::move(mapped));
+    EXPECT(mapped.empty() && 3 == moved.size());
+
+    Line line = make_line({{1, 2}, {3, 4}});
+    write_line(file.path, line);
+    MappedLines single(file.path);
+    EXPECT(1 == single.size() && same_points(line, single[0]));
+
+    write_lines(file.path, LineCollection());
+    EXPECT(MappedLines(file.path).empty());
+}
+
+void test_io_bad_files()
+{
+    LineCollection lines;
+    lines.append(make_line({{0, 1}, {2, 3}}));
+    TempFile file;
+
+    EXPECT(throws<std::runtime_error>([] { MappedLines mapped("/nonexistent/line_test"); }));
+
+    write_lines(file.path, lines);
+    patch_header(file, [](LineFileHeader &header) { header.magic[0] = 'X'; });
+    EXPECT(rejected(file));
+
+    write_lines(file.path, lines);
+    patch_header(file, [](LineFileHeader &header) { header.version = line_file_version + 1; });
+    EXPECT(rejected(file));
+
+    write_lines(file.path, lines);
+    patch_header(file, [](LineFileHeader &header) { header.byte_order = 0x04030201; });
+    EXPECT(rejected(file));
+
+    // Short of the header, and short of the coordinates.
+    write_lines(file.path, lines);
+    std::vector<char> bytes = file.read();
+    file.write(std::vector<char>(bytes.begin(), bytes.begin() + 10));
+    EXPECT(rejected(file));
+    file.write(std::vector<char>(bytes.begin(), bytes.end() - 1));
+    EXPECT(rejected(file));
+
+    write_lines(file.path, lines);
+    patch_header(file, [](LineFileHeader &header) { header.npoint = 3; });
+    EXPECT(rejected(file));
+
+    // Offsets that would wrap around past the end of the mapping.
+    uint64_t const huge = std::numeric_limits<uint64_t>::max() - 7;
+    write_lines(file.path, LineCollection());
+    EXPECT(128 == file.read().size());
+    patch_header(file, [&](LineFileHeader &header) { header.offsets_offset = huge; });
+    EXPECT(rejected(file));
+    write_lines(file.path, lines);
+    patch_header(file, [&](LineFileHeader &header) { header.coord_offset = huge; });
+    EXPECT(rejected(file));
+}
+
+void test_collection_build()
+{
+    std::vector<Line> lines = {make_line({{0, 1}, {2, 3}}), Line(), make_line({{4, 5}, {6, 7}, {8, 9}})};
+    LineCollection collection(lines);
+    EXPECT(3 == collection.size() && 5 == collection.point_count());
+    EXPECT(0 == collection.offsets()[0] && 2 == collection.offsets()[1] && 2 == collection.offsets()[2]);
+    size_t count = 0;
+    for (ConstLineView view : static_cast<LineCollection const &>(collection))
+    {
+        EXPECT(same_points(view, lines[count]));
+        EXPECT(same_points(collection.line(count), lines[count]));
+        ++count;
+    }
+    EXPECT(3 == count);
+    EXPECT(throws<std::out_of_range>([&] { collection.at(3); }));
+
+    std::vector<SoaLine> soa(2);
+    soa[1].push_back(1, 2);
+    LineCollection from_soa(soa);
+    EXPECT(2 == from_soa.size() && 0 == from_soa.line_size(0) && same_points(from_soa[1], soa[1]));
+
+    // Empty lines take no points.
+    LineCollection empty;
+    EXPECT(empty.empty() && 0 == empty.point_count());
+    empty.append(0);
+    empty.append(Line());
+    EXPECT(2 == empty.size() && 0 == empty.point_count() && 0 == empty.line(1).size());
+    empty.clear();
+    EXPECT(empty.empty());
+}
+
+void test_collection_append_self()
+{
+    // Every append of a view of the collection itself may reallocate the
+    // buffer the view points into.
+    LineCollection collection;
+    collection.append(make_line({{1, 2}, {3, 4}, {5, 6}}));
+    collection.shrink_to_fit();
+    for (size_t it = 0; it < 20; ++it)
+    {
+        collection.append(ConstLineView(collection[it]));
+    }
+    collection.append(collection[collection.size() - 1]);
+    EXPECT(22 == collection.size() && 66 == collection.point_count());
+    for (ConstLineView view : static_cast<LineCollection const &>(collection))
+    {
+        EXPECT(same_points(view, make_line({{1, 2}, {3, 4}, {5, 6}})));
+    }
+}
+
+void test_collection_reserve()
+{
+    LineCollection collection;
+    collection.append(make_line({{1, 2}}));
+    collection.reserve(5, 40);
+    float const *coord = collection.data();
+    size_t const *offsets = collection.offsets();
+    for (size_t it = 1; it < 5; ++it)
+    {
+        collection.append(make_wave(8));
+    }
+    EXPECT(coord == collection.data() && offsets == collection.offsets());
+    EXPECT(33 == collection.point_count());
+}
+
+void test_douglas_peucker()
+{
+    Line wave = make_wave(100000);
+    SimplifyWorkspace ws;
+    Line serial, threaded, automatic;
+    simplify_douglas_peucker(wave, serial, 0.5f, ws, 1);
+    simplify_douglas_peucker(wave, threaded, 0.5f, ws, 4);
+    simplify_douglas_peucker(wave, automatic, 0.5f, 0);
+    EXPECT(serial.size() > 2 && serial.size() < wave.size());
+    EXPECT(same_points(serial, threaded));
+    EXPECT(same_points(serial, automatic));
+
+    // Spikes near either end make the first splits too lopsided to thread.
+    Line spiky = wave;
+    spiky.y(5) = 1e4f;
+    spiky.y(99990) = -1e4f;
+    simplify_douglas_peucker(spiky, serial, 0.5f, ws, 1);
+    simplify_douglas_peucker(spiky, threaded, 0.5f, ws, 4);
+    EXPECT(serial.size() > 4 && same_points(serial, threaded));
+
+    // A tolerance wider than the line keeps the end points only.
+    Line ends;
+    simplify_douglas_peucker(wave, ends, 1e6f, ws, 4);
+    EXPECT(same_points(ends, make_line({{wave.x(0), wave.y(0)}, {wave.x(99999), wave.y(99999)}})));
+
+    // Tolerance 0 drops collinear points only.
+    Line zigzag = make_line({{0, 0}, {1, 1}, {2, 0}, {3, 1}, {4, 0}});
+    Line out;
+    simplify_douglas_peucker(zigzag, out, 0, ws);
+    EXPECT(same_points(zigzag, out));
+    simplify_douglas_peucker(make_line({{0, 0}, {1, 0}, {2, 0}, {2, 3}}), out, 0, ws);
+    EXPECT(same_points(out, make_line({{0, 0}, {2, 0}, {2, 3}})));
+}
+
+void test_visvalingam()
+{
+    SimplifyWorkspace ws;
+    Line out;
+    // The flat bump at x = 1 goes first; then x = 2 has area 5.
+    Line shape = make_line({{0, 0}, {1, 0.1f}, {2, 0}, {3, 5}, {4, 0}});
+    simplify_visvalingam(shape, out, 1, ws);
+    EXPECT(same_points(out, make_line({{0, 0}, {2, 0}, {3, 5}, {4, 0}})));
+    simplify_visvalingam(shape, out, 0.05f, ws);
+    EXPECT(same_points(out, shape));
+    simplify_visvalingam(shape, out, 100);
+    EXPECT(same_points(out, make_line({{0, 0}, {4, 0}})));
+}
+
+void test_simplify_short_lines()
+{
+    SimplifyWorkspace ws;
+    for (size_t npoint = 0; npoint <= 2; ++npoint)
+    {
+        Line in = make_wave(npoint), out;
+        simplify_douglas_peucker(in, out, 1e6f, ws, 4);
+        EXPECT(same_points(in, out));
+        simplify_visvalingam(in, out, 1e6f, ws);
+        EXPECT(same_points(in, out));
+    }
+}
+
+void test_simplify_reuse()
+{
+    Line wave = make_wave(20000);
+    SimplifyWorkspace ws;
+    Line out;
+    out.reserve(wave.size());
+    float const *buffer = out.data();
+    SoaLine soa(wave.size());
+    for (size_t it = 0; it < wave.size(); ++it)
+    {
+        soa.x(it) = wave.x(it);
+        soa.y(it) = wave.y(it);
+    }
+    for (float tolerance : {0.1f, 10.f, 0.f})
+    {
+        simplify_douglas_peucker(wave, out, tolerance, ws, 2);
+        EXPECT(buffer == out.data());
+        simplify_visvalingam(soa, out, tolerance, ws);
+        EXPECT(buffer == out.data());
+    }
+    EXPECT(throws<std::invalid_argument>([&] { simplify_douglas_peucker(wave, wave, 1, ws); }));
+}
+
+/* The named counter since the last reset(), 0 if it never counted */
+uint64_t counted(char const *name)
+{
+    std::map<std::string, uint64_t> counters = instrument::snapshot();
+    auto found = counters.find(name);
+    return counters.end() == found ? 0 : found->second;
+}
+
+void test_instrument()
+{
+    if (!instrument::enabled)
+    {
+        EXPECT(instrument::snapshot().empty());
+        return;
+    }
+    Line line = make_wave(10);
+    instrument::reset();
+    EXPECT(0 == counted("line.copy") && 0 == counted("line.alloc.calls"));
+
+    Line copy = line;
+    copy = line;
+    Line moved = std::move(copy);
+    copy = std::move(moved);
+    EXPECT(1 == counted("line.copy") && 1 == counted("line.copy_assign"));
+    EXPECT(1 == counted("line.move") && 1 == counted("line.move_assign"));
+    EXPECT(1 == counted("line.alloc.calls") && 2 * 10 * sizeof(float) == counted("line.alloc.bytes"));
+
+    CowLine cow(3), shared;
+    shared = cow;
+    shared.x(0) = 1;
+    EXPECT(1 == counted("line.cow_detach"));
+
+    // Copies made on other threads count too, after those threads exit.
+    std::thread other([&] { Line local = line; });
+    other.join();
+    EXPECT(2 == counted("line.copy"));
+
+    length(line);
+    length(line);
+    EXPECT(2 == counted("line_kernels.length.calls"));
+
+    instrument::reset();
+    EXPECT(0 == counted("line.copy") && 0 == counted("line_kernels.length.calls"));
+}
+
+} /* end namespace */
+
+int main(int, char **)
+{
+    test_line_assign();
+    test_line_capacity();
+    test_soa_line();
+    test_arena();
+    test_pool();
+    test_arena_line_assign();
+    test_cow_line();
+    test_kernel_isas();
+    test_collection_build();
+    test_collection_append_self();
+    test_collection_reserve();
+    test_io_round_trip();
+    test_io_bad_files();
+    test_douglas_peucker();
+    test_visvalingam();
+    test_simplify_short_lines();
+    test_simplify_reuse();
+    test_instrument();
+
+    if (failures)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    std::printf("all checks passed\n");
+    return 0;
+}
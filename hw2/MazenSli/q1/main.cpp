@@ -1,8 +1,10 @@
 #include "line.hpp"
+#include "line_io.hpp"
 
 int main(int, char **)
 {
-    Line line(3);
+    // line2 is a snapshot of line; it copies the points only when changed.
+    CowLine line(3);
     line.x(0) = 0;
     line.y(0) = 1;
     line.x(1) = 1;
@@ -10,24 +12,12 @@ int main(int, char **)
     line.x(2) = 2;
     line.y(2) = 5;
 
-    Line line2(line);
+    CowLine line2(line);
     line2.x(0) = 9;
 
-    std::cout << "line: number of points = " << line.size() << std::endl;
-    for (size_t it = 0; it < line.size(); ++it)
-    {
-        std::cout << "point " << it << ":"
-                  << " x = " << line.x(it)
-                  << " y = " << line.y(it) << std::endl;
-    }
-
-    std::cout << "line2: number of points = " << line.size() << std::endl;
-    for (size_t it = 0; it < line.size(); ++it)
-    {
-        std::cout << "point " << it << ":"
-                  << " x = " << line2.x(it)
-                  << " y = " << line2.y(it) << std::endl;
-    }
+    LineTextWriter writer(std::cout);
+    writer.write("line", line);
+    writer.write("line2", line2);
 
     return 0;
 }
@@ -2,31 +2,382 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <math.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
+#include "angle.hpp"
+#include "instrument.hpp"
+#include "thread_pool.hpp"
+
 namespace py = pybind11;
 
 float calc_angle(std::array<float, 2> v1, std::array<float, 2> v2)
 {
-    float len1 = sqrt(v1[0] * v1[0] + v1[1] * v1[1]);
-    float len2 = sqrt(v2[0] * v2[0] + v2[1] * v2[1]);
-    float len = len1 * len2;
+    INSTRUMENT_TIME("calc_angle");
+    if (angle_degenerate(v1[0], v1[1], v2[0], v2[1]))
+        throw std::invalid_argument("Division by zero not allowed!");
+
+    return angle_between(v1[0], v1[1], v2[0], v2[1]);
+}
+
+/*
+ * Angles between n pairs of 2D vectors: v1 + i * stride and v2 + i * stride
+ * for i in [0, n).  Degenerate pairs get fill instead, and valid[i] is set to
+ * whether pair i was usable when valid is not null.  Returns the number of
+ * degenerate pairs; the loop has no branches or exception paths, so in fast
+ * mode the compiler vectorizes it (given -fno-math-errno and
+ * -fno-trapping-math).
+ */
+template <typename T, AngleMode mode, size_t stride, bool masked>
+size_t calc_angles_loop(T const *__restrict v1, T const *__restrict v2, size_t n, T *__restrict out,
+                        T fill, bool *__restrict valid) noexcept
+{
+    size_t ndegenerate = 0;
+    for (size_t it = 0; it < n; ++it)
+    {
+        T const *a = v1 + it * stride;
+        T const *b = v2 + it * stride;
+        bool degenerate = angle_degenerate(a[0], a[1], b[0], b[1]);
+        T angle = angle_between<T, mode>(a[0], a[1], b[0], b[1]);
+        out[it] = degenerate ? fill : angle;
+        ndegenerate += degenerate;
+        if (masked)
+            valid[it] = !degenerate;
+    }
+    return ndegenerate;
+}
+
+template <typename T, AngleMode mode, size_t stride>
+size_t calc_angles(T const *v1, T const *v2, size_t n, T *out, T fill, bool *valid) noexcept
+{
+    // GCC does not unswitch the loop on valid, so pick the loop here.
+    if (valid)
+        return calc_angles_loop<T, mode, stride, true>(v1, v2, n, out, fill, valid);
+    return calc_angles_loop<T, mode, stride, false>(v1, v2, n, out, fill, nullptr);
+}
+
+/* Workers shared by every batch call; the calling thread makes one more */
+ThreadPool &angle_pool()
+{
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+/* Thread count for calls that pass nthread=0; 0 here means every core */
+std::atomic<size_t> default_nthread{0};
+
+/* Threads for nwork items: at most one per grain items and one per core */
+size_t angle_threads(size_t nthread, size_t nwork, size_t grain)
+{
+    if (0 == nthread)
+        nthread = default_nthread;
+    if (0 == nthread)
+        nthread = angle_pool().size();
+    return std::min({nthread, angle_pool().size(), std::max<size_t>(nwork / grain, 1)});
+}
+
+/*
+ * calc_angles split into one contiguous chunk per thread.  Inputs below
+ * parallel_grain elements per thread stay on the calling thread.
+ */
+template <typename T, AngleMode mode, size_t stride>
+size_t calc_angles_parallel(T const *v1, T const *v2, size_t n, T *out, T fill, bool *valid, size_t nthread)
+{
+    size_t const parallel_grain = 1 << 16;
+
+    nthread = angle_threads(nthread, n, parallel_grain);
+    if (nthread < 2)
+        return calc_angles<T, mode, stride>(v1, v2, n, out, fill, valid);
+
+    size_t chunk = (n + nthread - 1) / nthread;
+    std::vector<size_t> ndegenerate(nthread, 0);
+    angle_pool().run(nthread, [&](size_t it) {
+        size_t begin = it * chunk;
+        size_t end = std::min(begin + chunk, n);
+        if (begin < end)
+            ndegenerate[it] = calc_angles<T, mode, stride>(v1 + begin * stride, v2 + begin * stride, end - begin,
+                                                           out + begin, fill, valid ? valid + begin : nullptr);
+    });
+    return std::accumulate(ndegenerate.begin(), ndegenerate.end(), size_t(0));
+}
+
+/*
+ * All-pairs angles between n vectors.  The vectors are normalized once into
+ * separate x and y arrays, so the inner loop reads two contiguous arrays.
+ * The squared lengths are kept too, so that a pair is degenerate by the
+ * same rule as in calc_angles (angle_degenerate) and gets fill.
+ */
+template <typename T>
+struct UnitVectors
+{
+    std::vector<T> x, y, len2;
+
+    UnitVectors(T const *v, size_t n) : x(n), y(n), len2(n)
+    {
+        for (size_t it = 0; it < n; ++it)
+        {
+            len2[it] = v[2 * it] * v[2 * it] + v[2 * it + 1] * v[2 * it + 1];
+            T scale = len2[it] > 0 ? 1 / std::sqrt(len2[it]) : 0;
+            x[it] = v[2 * it] * scale;
+            y[it] = v[2 * it + 1] * scale;
+        }
+    }
 
-    if (len < pow(10, -4))
+    size_t size() const { return x.size(); }
+}; /* end struct UnitVectors */
+
+/* Angles between vector i and vectors [j0, j1) */
+template <typename T, AngleMode mode>
+void angle_row(UnitVectors<T> const &u, size_t i, size_t j0, size_t j1, T *__restrict out, T fill) noexcept
+{
+    T const eps2 = angle_epsilon<T> * angle_epsilon<T>;
+    T alen2 = u.len2[i];
+    if (0 == alen2)
+    {
+        std::fill(out, out + (j1 - j0), fill);
+        return;
+    }
+    T ax = u.x[i], ay = u.y[i];
+    T const *__restrict bx = u.x.data();
+    T const *__restrict by = u.y.data();
+    T const *__restrict blen2 = u.len2.data();
+    for (size_t j = j0; j < j1; ++j)
+    {
+        T angle = angle_between<T, mode>(ax, ay, bx[j], by[j]);
+        out[j - j0] = alen2 * blen2[j] > eps2 ? angle : fill;
+    }
+}
+
+/* The tile of rows [i0, i1) and columns [j0, j1); row r starts at out + r * ld */
+template <typename T, AngleMode mode>
+void angle_tile(UnitVectors<T> const &u, size_t i0, size_t i1, size_t j0, size_t j1, T *out, size_t ld, T fill) noexcept
+{
+    for (size_t i = i0; i < i1; ++i)
+        angle_row<T, mode>(u, i, j0, j1, out + (i - i0) * ld, fill);
+}
+
+/*
+ * The full n x n matrix, or with upper set the n (n - 1) / 2 angles above the
+ * diagonal in row-major order (the condensed form scipy's squareform takes).
+ * Rows are cut into bands of tile rows, and each band walks the columns tile
+ * by tile, so a band re-reads only tile vectors at a time.  Thread t takes
+ * bands t, t + nthread, ..., which also balances the triangle.
+ */
+template <typename T, AngleMode mode>
+void angle_matrix(UnitVectors<T> const &u, bool upper, T *out, T fill, size_t nthread)
+{
+    size_t const tile = 256;
+    size_t n = u.size();
+    size_t nband = (n + tile - 1) / tile;
+
+    nthread = angle_threads(nthread, n * n, size_t(1) << 18);
+    angle_pool().run(nthread, [&](size_t thread) {
+        for (size_t band = thread; band < nband; band += nthread)
+        {
+            size_t i0 = band * tile, i1 = std::min(i0 + tile, n);
+            for (size_t j0 = upper ? i0 : 0; j0 < n; j0 += tile)
+            {
+                size_t j1 = std::min(j0 + tile, n);
+                for (size_t i = i0; i < i1; ++i)
+                {
+                    if (!upper)
+                        angle_row<T, mode>(u, i, j0, j1, out + i * n + j0, fill);
+                    else if (j1 > i + 1)
+                    {
+                        size_t begin = std::max(j0, i + 1);
+                        angle_row<T, mode>(u, i, begin, j1, out + i * n - i * (i + 1) / 2 + begin - i - 1, fill);
+                    }
+                }
+            }
+        }
+    });
+}
+
+template <typename T>
+using input_array = py::array_t<T, py::array::c_style | py::array::forcecast>;
+
+/*
+ * The Python entry points hold the GIL only to check shapes and allocate the
+ * result, so other Python threads keep running during the computation.
+ * float64 input gives a float64 result; anything else is computed in float32.
+ *
+ * Degenerate pairs raise ValueError unless fill is given or return_mask is
+ * set.  Then they get fill (NaN by default) and the call never raises for
+ * them; return_mask also returns a bool array that is False where that
+ * happened.
+ *
+ * Instrumented, each entry point times its whole body and, separately, the
+ * .compute part without the GIL; the difference is the Python side (results
+ * and checks).  Argument conversion happens in pybind11 before the call.
+ */
+template <typename T, size_t stride>
+py::object calc_angles_run(T const *v1, T const *v2, size_t n, size_t nthread, bool fast,
+                           std::optional<T> fill, bool return_mask)
+{
+    INSTRUMENT_TIME("calc_angles");
+    INSTRUMENT_COUNT("calc_angles.pairs", n);
+    py::array_t<T> ret(n);
+    py::array_t<bool> valid(return_mask ? n : 0);
+    T *out = ret.mutable_data();
+    bool *mask = return_mask ? valid.mutable_data() : nullptr;
+    T value = fill ? *fill : std::numeric_limits<T>::quiet_NaN();
+    size_t ndegenerate;
+    {
+        py::gil_scoped_release release;
+        INSTRUMENT_TIME("calc_angles.compute");
+        if (fast)
+            ndegenerate = calc_angles_parallel<T, AngleMode::fast, stride>(v1, v2, n, out, value, mask, nthread);
+        else
+            ndegenerate = calc_angles_parallel<T, AngleMode::exact, stride>(v1, v2, n, out, value, mask, nthread);
+    }
+    if (ndegenerate && !fill && !return_mask)
         throw std::invalid_argument("Division by zero not allowed!");
+    if (return_mask)
+        return py::make_tuple(ret, valid);
+    return std::move(ret);
+}
 
-    float dot = v1[0] * v2[0] + v1[1] * v2[1];
+/* calc_angles(v1, v2) with two (n, 2) arrays */
+template <typename T>
+py::object calc_angles_pair(input_array<T> v1, input_array<T> v2, size_t nthread, bool fast,
+                            std::optional<T> fill, bool return_mask)
+{
+    if (v1.ndim() != 2 || v1.shape(1) != 2 || v2.ndim() != 2 || v2.shape(1) != 2)
+        throw std::invalid_argument("calc_angles needs two (n, 2) arrays");
+    if (v1.shape(0) != v2.shape(0))
+        throw std::invalid_argument("calc_angles needs arrays of the same length");
 
-    if (dot / len > 1 || dot / len < -1)
-        throw std::invalid_argument("Invalid argument for acos calculation");
+    return calc_angles_run<T, 2>(v1.data(), v2.data(), v1.shape(0), nthread, fast, fill, return_mask);
+}
 
-    return acos(dot / len);
+/* calc_angles(v) with one (n, 4) array holding v1 and v2 side by side */
+template <typename T>
+py::object calc_angles_packed(input_array<T> v, size_t nthread, bool fast, std::optional<T> fill, bool return_mask)
+{
+    if (v.ndim() != 2 || v.shape(1) != 4)
+        throw std::invalid_argument("calc_angles needs an (n, 4) array");
+
+    return calc_angles_run<T, 4>(v.data(), v.data() + 2, v.shape(0), nthread, fast, fill, return_mask);
+}
+
+template <typename T>
+UnitVectors<T> unit_vectors(input_array<T> const &v)
+{
+    if (v.ndim() != 2 || v.shape(1) != 2)
+        throw std::invalid_argument("angle_matrix needs an (n, 2) array");
+    return UnitVectors<T>(v.data(), v.shape(0));
+}
+
+/* angle_matrix(v): the (n, n) matrix, or the condensed upper triangle */
+template <typename T>
+py::array_t<T> angle_matrix_py(input_array<T> v, bool upper, bool fast, T fill, size_t nthread)
+{
+    INSTRUMENT_TIME("angle_matrix");
+    UnitVectors<T> u = unit_vectors(v);
+    size_t n = u.size();
+    py::array_t<T> ret = upper ? py::array_t<T>(n ? n * (n - 1) / 2 : 0) : py::array_t<T>({n, n});
+    T *out = ret.mutable_data();
+    {
+        py::gil_scoped_release release;
+        INSTRUMENT_TIME("angle_matrix.compute");
+        if (fast)
+            angle_matrix<T, AngleMode::fast>(u, upper, out, fill, nthread);
+        else
+            angle_matrix<T, AngleMode::exact>(u, upper, out, fill, nthread);
+    }
+    return ret;
 }
 
-PYBIND11_MODULE(example, m) {
+/*
+ * angle_matrix_tiles(v, callback): call callback(i0, j0, block) for every
+ * tile x tile block of the matrix (only blocks on or above the diagonal with
+ * upper), in row-major block order, without ever holding the whole matrix.
+ * Blocks are computed a batch of one per thread at a time with the GIL
+ * released; the callbacks then run in order on the calling thread.  Each
+ * block is a new array the callback may keep.
+ */
+template <typename T>
+void angle_matrix_tiles_py(input_array<T> v, py::function callback, size_t tile, bool upper, bool fast, T fill,
+                           size_t nthread)
+{
+    if (0 == tile)
+        throw std::invalid_argument("angle_matrix_tiles needs a positive tile size");
+    INSTRUMENT_TIME("angle_matrix_tiles");
+    UnitVectors<T> u = unit_vectors(v);
+    size_t n = u.size();
+    size_t ntile = (n + tile - 1) / tile;
+
+    std::vector<std::pair<size_t, size_t>> tiles;
+    for (size_t ti = 0; ti < ntile; ++ti)
+        for (size_t tj = upper ? ti : 0; tj < ntile; ++tj)
+            tiles.emplace_back(ti * tile, tj * tile);
+
+    nthread = angle_threads(nthread, tiles.size(), 1);
+    std::vector<py::array_t<T>> blocks(nthread);
+    std::vector<T *> outs(nthread);
+    for (size_t first = 0; first < tiles.size(); first += nthread)
+    {
+        size_t nbatch = std::min(nthread, tiles.size() - first);
+        for (size_t it = 0; it < nbatch; ++it)
+        {
+            size_t i0 = tiles[first + it].first, j0 = tiles[first + it].second;
+            blocks[it] = py::array_t<T>({std::min(tile, n - i0), std::min(tile, n - j0)});
+            outs[it] = blocks[it].mutable_data();
+        }
+        {
+            py::gil_scoped_release release;
+            INSTRUMENT_TIME("angle_matrix_tiles.compute");
+            angle_pool().run(nbatch, [&](size_t it) {
+                size_t i0 = tiles[first + it].first, j0 = tiles[first + it].second;
+                size_t i1 = std::min(i0 + tile, n), j1 = std::min(j0 + tile, n);
+                if (fast)
+                    angle_tile<T, AngleMode::fast>(u, i0, i1, j0, j1, outs[it], j1 - j0, fill);
+                else
+                    angle_tile<T, AngleMode::exact>(u, i0, i1, j0, j1, outs[it], j1 - j0, fill);
+            });
+        }
+        for (size_t it = 0; it < nbatch; ++it)
+            callback(tiles[first + it].first, tiles[first + it].second, std::move(blocks[it]));
+    }
+}
+
+PYBIND11_MODULE(angle, m) {
     m.doc() = "pybind11 angle"; // optional module docstring
     m.def("calc_angle", &calc_angle, "A function which calculates the angle between two 2D-vectors in radians");
+    // float32 overloads first: they take any input that needs converting.
+    m.def("calc_angles", &calc_angles_pair<float>, "Angles in radians between the rows of two (n, 2) arrays",
+          py::arg("v1"), py::arg("v2"), py::arg("nthread") = 0, py::arg("fast") = false,
+          py::arg("fill") = py::none(), py::arg("return_mask") = false);
+    m.def("calc_angles", &calc_angles_packed<float>, "Angles in radians between the two halves of each row of an (n, 4) array",
+          py::arg("v"), py::arg("nthread") = 0, py::arg("fast") = false,
+          py::arg("fill") = py::none(), py::arg("return_mask") = false);
+    m.def("calc_angles", &calc_angles_pair<double>, py::arg("v1"), py::arg("v2"), py::arg("nthread") = 0,
+          py::arg("fast") = false, py::arg("fill") = py::none(), py::arg("return_mask") = false);
+    m.def("calc_angles", &calc_angles_packed<double>, py::arg("v"), py::arg("nthread") = 0,
+          py::arg("fast") = false, py::arg("fill") = py::none(), py::arg("return_mask") = false);
+    m.def("angle_matrix", &angle_matrix_py<float>, "All-pairs angles in radians between the rows of an (n, 2) array",
+          py::arg("v"), py::arg("upper") = false, py::arg("fast") = false,
+          py::arg("fill") = std::numeric_limits<float>::quiet_NaN(), py::arg("nthread") = 0);
+    m.def("angle_matrix", &angle_matrix_py<double>, py::arg("v"), py::arg("upper") = false, py::arg("fast") = false,
+          py::arg("fill") = std::numeric_limits<double>::quiet_NaN(), py::arg("nthread") = 0);
+    m.def("angle_matrix_tiles", &angle_matrix_tiles_py<float>, "Stream all-pairs angles to callback(i0, j0, block)",
+          py::arg("v"), py::arg("callback"), py::arg("tile") = 1024, py::arg("upper") = false, py::arg("fast") = false,
+          py::arg("fill") = std::numeric_limits<float>::quiet_NaN(), py::arg("nthread") = 0);
+    m.def("angle_matrix_tiles", &angle_matrix_tiles_py<double>, py::arg("v"), py::arg("callback"),
+          py::arg("tile") = 1024, py::arg("upper") = false, py::arg("fast") = false,
+          py::arg("fill") = std::numeric_limits<double>::quiet_NaN(), py::arg("nthread") = 0);
+    m.def("set_num_threads", [](size_t nthread) { default_nthread = nthread; },
+          "Thread count for calc_angles calls without nthread; 0 uses every core");
+    m.def("get_num_threads", []() { return default_nthread.load() ? default_nthread.load() : angle_pool().size(); });
+    m.attr("instrumented") = instrument::enabled;
+    m.def("stats", &instrument::snapshot,
+          "Instrument counters since the last reset_stats(), over all threads; empty unless built with INSTRUMENT=1");
+    m.def("reset_stats", &instrument::reset, "Count the instruments from zero again");
 }
-
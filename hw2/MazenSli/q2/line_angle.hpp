@@ -0,0 +1,95 @@
+#pragma once
+
+#include <limits>
+
+#include "angle.hpp"
+#include "line.hpp"
+#include "line_collection.hpp"
+
+/*
+ * Turning angles of polylines.  Angle i of a line is the angle between the
+ * segments (i, i+1) and (i+1, i+2), so a line of n points has n - 2 of them
+ * (none below 3 points).  The segment vectors are formed from the coordinates
+ * as the loop goes.  Coordinates have no natural scale, so only a segment of
+ * exactly zero length makes a vertex degenerate; such vertices get fill and
+ * every function returns how many there were.
+ */
+
+/* Number of turning angles of a line with npoint points */
+inline size_t turning_angle_count(size_t npoint) { return npoint < 3 ? 0 : npoint - 2; }
+
+/*
+ * The loop over nangle vertices.  A non-zero stride template argument fixes
+ * the stride of both axes at compile time, so the loop vectorizes; zero uses
+ * the run-time strides.
+ */
+template <AngleMode mode, ptrdiff_t stride>
+size_t turning_angles_loop(float const *__restrict xs, float const *__restrict ys, ptrdiff_t xstride,
+                           ptrdiff_t ystride, size_t nangle, float *__restrict out, float fill) noexcept
+{
+    if (stride)
+        xstride = ystride = stride;
+    size_t ndegenerate = 0;
+    for (size_t it = 0; it < nangle; ++it)
+    {
+        float ux = xs[(it + 1) * xstride] - xs[it * xstride];
+        float uy = ys[(it + 1) * ystride] - ys[it * ystride];
+        float vx = xs[(it + 2) * xstride] - xs[(it + 1) * xstride];
+        float vy = ys[(it + 2) * ystride] - ys[(it + 1) * ystride];
+        bool degenerate = ((ux == 0) & (uy == 0)) | ((vx == 0) & (vy == 0));
+        float angle = angle_between<float, mode>(ux, uy, vx, vy);
+        out[it] = degenerate ? fill : angle;
+        ndegenerate += degenerate;
+    }
+    return ndegenerate;
+}
+
+/* Write the turning_angle_count(xs.size()) angles of a line to out */
+template <AngleMode mode = AngleMode::exact>
+size_t turning_angles(StridedSpan<float const> xs, StridedSpan<float const> ys, float *out,
+                      float fill = std::numeric_limits<float>::quiet_NaN())
+{
+    size_t nangle = turning_angle_count(xs.size());
+    if (xs.stride() == ys.stride() && 2 == xs.stride())
+        return turning_angles_loop<mode, 2>(xs.data(), ys.data(), 2, 2, nangle, out, fill);
+    if (xs.stride() == ys.stride() && 1 == xs.stride())
+        return turning_angles_loop<mode, 1>(xs.data(), ys.data(), 1, 1, nangle, out, fill);
+    return turning_angles_loop<mode, 0>(xs.data(), ys.data(), xs.stride(), ys.stride(), nangle, out, fill);
+}
+
+template <AngleMode mode = AngleMode::exact, typename L>
+size_t turning_angles(L const &line, float *out, float fill = std::numeric_limits<float>::quiet_NaN())
+{
+    return turning_angles<mode>(line.xs(), line.ys(), out, fill);
+}
+
+/* Total number of turning angles over every line of a collection */
+inline size_t turning_angle_count(LineCollection const &lines)
+{
+    size_t ret = 0;
+    for (size_t it = 0; it < lines.size(); ++it)
+        ret += turning_angle_count(lines.line_size(it));
+    return ret;
+}
+
+/*
+ * The angles of every line of the collection, back to back in line order,
+ * in one pass over the shared buffer.  out has turning_angle_count(lines)
+ * entries.
+ */
+template <AngleMode mode = AngleMode::exact>
+size_t turning_angles(LineCollection const &lines, float *out,
+                      float fill = std::numeric_limits<float>::quiet_NaN())
+{
+    float const *coord = lines.data();
+    size_t const *offsets = lines.offsets();
+    size_t ndegenerate = 0;
+    for (size_t it = 0; it < lines.size(); ++it)
+    {
+        float const *first = coord + 2 * offsets[it];
+        size_t nangle = turning_angle_count(offsets[it + 1] - offsets[it]);
+        ndegenerate += turning_angles_loop<mode, 2>(first, first + 1, 2, 2, nangle, out, fill);
+        out += nangle;
+    }
+    return ndegenerate;
+}
@@ -0,0 +1,83 @@
+#include <cstring>
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include "instrument.hpp"
+#include "line.hpp"
+#include "line_angle.hpp"
+
+namespace py = pybind11;
+
+/* Copy an (n, 2) array into a new Line with one memcpy */
+Line line_from_array(py::array_t<float, py::array::c_style | py::array::forcecast> arr)
+{
+    if (arr.ndim() != 2 || arr.shape(1) != 2)
+        throw std::invalid_argument("Line needs an (n, 2) array");
+
+    INSTRUMENT_TIME("line.from_array");
+    Line line(arr.shape(0));
+    std::memcpy(line.data(), arr.data(), sizeof(float) * 2 * line.size());
+    return line;
+}
+
+/* The n - 2 angles between consecutive segments; see line_angle.hpp */
+py::array_t<float> line_turning_angles(Line const &line, bool fast, float fill)
+{
+    INSTRUMENT_TIME("line.turning_angles");
+    py::array_t<float> ret(turning_angle_count(line.size()));
+    if (fast)
+        turning_angles<AngleMode::fast>(line, ret.mutable_data(), fill);
+    else
+        turning_angles(line, ret.mutable_data(), fill);
+    return ret;
+}
+
+/*
+ * A Python index into the line, negative ones counting from the end.  The
+ * check is explicit, since Line itself is unchecked under NDEBUG.
+ */
+size_t line_index(Line const &line, ptrdiff_t it)
+{
+    ptrdiff_t size = line.size();
+    if (it < 0)
+        it += size;
+    if (it < 0 || it >= size)
+        throw py::index_error("Line index out of range");
+    return it;
+}
+
+PYBIND11_MODULE(_line, m) {
+    m.doc() = "pybind11 line"; // optional module docstring
+
+    // numpy.asarray(line) is an (n, 2) float32 view of the coordinates.  It
+    // stays valid until the line is resized.
+    py::class_<Line>(m, "Line", py::buffer_protocol())
+        .def(py::init<>())
+        .def(py::init<size_t>())
+        .def(py::init(&line_from_array), "Copy an (n, 2) float32 array")
+        .def_buffer([](Line &line) -> py::buffer_info {
+            return py::buffer_info(
+                line.data(), sizeof(float), py::format_descriptor<float>::format(), 2,
+                {line.size(), size_t(2)}, {sizeof(float) * 2, sizeof(float)});
+        })
+        .def("__len__", &Line::size)
+        .def_property_readonly("size", &Line::size)
+        .def("__getitem__", [](Line const &line, ptrdiff_t it) {
+            size_t at = line_index(line, it);
+            return py::make_tuple(line.x(at), line.y(at));
+        })
+        .def("__setitem__", [](Line &line, ptrdiff_t it, std::pair<float, float> point) {
+            size_t at = line_index(line, it);
+            line.x(at) = point.first;
+            line.y(at) = point.second;
+        })
+        .def("copy", [](Line const &line) { return Line(line); })
+        .def("turning_angles", &line_turning_angles, "Angles in radians between consecutive segments",
+             py::arg("fast") = false, py::arg("fill") = std::numeric_limits<float>::quiet_NaN());
+    m.attr("instrumented") = instrument::enabled;
+    m.def("stats", &instrument::snapshot,
+          "Line copies, moves and allocations and kernel timers since the last reset_stats(); empty unless built "
+          "with INSTRUMENT=1");
+    m.def("reset_stats", &instrument::reset, "Count the instruments from zero again");
+}
@@ -1,11 +1,196 @@
 import unittest
+import numpy as np
 import angle
+import _line
 
 class testAngle(unittest.TestCase):
 
     def test_method1(self):
         assert angle.calc_angle([1, 1], [1, 1]) == 0
 
+    def test_near_parallel(self):
+        # acos(dot / len) used to see a ratio just above 1 here and throw.
+        assert angle.calc_angle([3, 7], [3.0000002, 7]) < 1e-6
+        self.assertAlmostEqual(angle.calc_angle([3, 7], [-3, -7]), np.pi, places=6)
+
+
+class testAngles(unittest.TestCase):
+
+    def test_match_scalar(self):
+        rng = np.random.default_rng(0)
+        v1 = rng.uniform(-10, 10, (1000, 2)).astype(np.float32)
+        v2 = rng.uniform(-10, 10, (1000, 2)).astype(np.float32)
+        ret = angle.calc_angles(v1, v2)
+        assert ret.shape == (1000,)
+        for it in range(0, 1000, 37):
+            self.assertAlmostEqual(ret[it], angle.calc_angle(v1[it], v2[it]), places=5)
+        packed = angle.calc_angles(np.hstack([v1, v2]))
+        assert (packed == ret).all()
+
+    def test_right_angle(self):
+        ret = angle.calc_angles(np.array([[1, 0], [0, 2]]), np.array([[0, 1], [3, 0]]))
+        assert np.allclose(ret, np.pi / 2)
+
+    def test_zero_length(self):
+        with self.assertRaises(ValueError):
+            angle.calc_angles(np.array([[1, 0], [0, 0]]), np.array([[1, 0], [1, 0]]))
+
+    def test_fill(self):
+        v = np.array([[1, 0, 0, 1], [0, 0, 1, 0], [1, 1, 0, 0]], dtype=np.float32)
+        ret = angle.calc_angles(v, fill=-1)
+        assert ret[1] == -1 and ret[2] == -1
+        self.assertAlmostEqual(ret[0], np.pi / 2, places=6)
+        ret, valid = angle.calc_angles(v[:, :2], v[:, 2:], return_mask=True)
+        assert (valid == [True, False, False]).all()
+        assert np.isnan(ret[1:]).all()
+
+    def test_fast(self):
+        rng = np.random.default_rng(2)
+        v = rng.uniform(-10, 10, (10000, 4)).astype(np.float32)
+        v[np.abs(v) < 0.1] = 1
+        exact = angle.calc_angles(v)
+        assert np.abs(angle.calc_angles(v, fast=True) - exact).max() < 5e-6
+
+    def test_double(self):
+        v = np.array([[1, 0, 0, 1], [1, 1, -1, -1]], dtype=np.float64)
+        ret = angle.calc_angles(v)
+        assert ret.dtype == np.float64
+        assert np.allclose(ret, [np.pi / 2, np.pi], rtol=0, atol=1e-15)
+        assert angle.calc_angles(v.astype(np.float32)).dtype == np.float32
+
+    def test_threads(self):
+        rng = np.random.default_rng(1)
+        v = rng.uniform(1, 10, (1 << 20, 4)).astype(np.float32)
+        serial = angle.calc_angles(v, nthread=1)
+        assert (angle.calc_angles(v, nthread=4) == serial).all()
+        assert (angle.calc_angles(v[:, :2], v[:, 2:], nthread=3) == serial).all()
+        v[-1] = 0
+        with self.assertRaises(ValueError):
+            angle.calc_angles(v, nthread=4)
+
+
+class testAngleMatrix(unittest.TestCase):
+
+    def setUp(self):
+        rng = np.random.default_rng(3)
+        self.v = rng.uniform(-10, 10, (600, 2)).astype(np.float32)
+        self.v[7] = 0
+        iu, ju = np.meshgrid(np.arange(600), np.arange(600), indexing="ij")
+        self.ref = angle.calc_angles(self.v[iu.ravel()], self.v[ju.ravel()], fill=-1).reshape(600, 600)
+
+    def test_full(self):
+        ret = angle.angle_matrix(self.v, fill=-1)
+        assert ret.shape == (600, 600)
+        assert np.abs(ret - self.ref).max() < 1e-5
+        assert (ret[7] == -1).all() and (ret[:, 7] == -1).all()
+
+    def test_upper(self):
+        ret = angle.angle_matrix(self.v, upper=True, fill=-1)
+        assert ret.shape == (600 * 599 // 2,)
+        assert np.abs(ret - self.ref[np.triu_indices(600, 1)]).max() < 1e-5
+
+    def test_tiles(self):
+        full = np.full((600, 600), np.inf, dtype=np.float32)
+
+        def store(i0, j0, block):
+            full[i0:i0 + block.shape[0], j0:j0 + block.shape[1]] = block
+
+        angle.angle_matrix_tiles(self.v, store, tile=256, fill=-1, fast=True)
+        assert np.abs(full - self.ref).max() < 5e-6
+        full[:] = np.inf
+        angle.angle_matrix_tiles(self.v, store, tile=256, upper=True, fill=-1)
+        iu = np.triu_indices(600, 1)
+        assert np.abs(full[iu] - self.ref[iu]).max() < 1e-5
+        assert np.isinf(full[300:, :256]).all()  # below the diagonal blocks.
+
+    def test_short_vector(self):
+        # Degenerate by the length product, as in calc_angles, not per vector.
+        v = np.array([[0.005, 0], [0, 10], [0.001, 0]], dtype=np.float32)
+        ret = angle.angle_matrix(v, fill=-1)
+        iu, ju = np.meshgrid(np.arange(3), np.arange(3), indexing="ij")
+        ref = angle.calc_angles(v[iu.ravel()], v[ju.ravel()], fill=-1).reshape(3, 3)
+        assert np.abs(ret - ref).max() < 1e-6
+        assert abs(ret[0, 1] - np.pi / 2) < 1e-6 and abs(ret[1, 2] - np.pi / 2) < 1e-6
+        assert ret[0, 2] == -1 and ret[0, 0] == -1
+
+
+class testLine(unittest.TestCase):
+
+    def test_buffer_is_view(self):
+        line = _line.Line(3)
+        line[1] = (1, 3)
+        arr = np.asarray(line)
+        assert arr.shape == (3, 2)
+        assert arr.dtype == np.float32
+        assert arr[1, 0] == 1 and arr[1, 1] == 3
+        arr[2] = (2, 5)
+        assert line[2] == (2, 5)
+
+    def test_from_array(self):
+        src = np.arange(8, dtype=np.float32).reshape(4, 2)
+        line = _line.Line(src)
+        assert len(line) == 4
+        assert line[3] == (6, 7)
+        src[3, 0] = 100
+        assert line[3] == (6, 7)  # copied, not shared.
+        with self.assertRaises(ValueError):
+            _line.Line(np.zeros((4, 3), dtype=np.float32))
+
+    def test_turning_angles(self):
+        line = _line.Line(np.array([[0, 0], [1, 0], [1, 1], [1, 1], [0, 2]], dtype=np.float32))
+        ret = line.turning_angles()
+        assert ret.shape == (3,)
+        self.assertAlmostEqual(ret[0], np.pi / 2, places=6)
+        assert np.isnan(ret[1:]).all()  # (1, 1) is repeated.
+        assert (line.turning_angles(fill=-1)[1:] == -1).all()
+        assert abs(line.turning_angles(fast=True)[0] - np.pi / 2) < 5e-6
+        assert len(_line.Line(2).turning_angles()) == 0
+
+    def test_index_error(self):
+        line = _line.Line(2)
+        with self.assertRaises(IndexError):
+            line[2]
+        with self.assertRaises(IndexError):
+            line[2] = (1, 2)
+        with self.assertRaises(IndexError):
+            line[-3]
+        with self.assertRaises(IndexError):
+            _line.Line()[0]
+
+    def test_negative_index(self):
+        line = _line.Line(3)
+        line[-1] = (4, 5)
+        assert line[2] == (4, 5) and line[-1] == (4, 5)
+        line[-3] = (1, 2)
+        assert line[0] == (1, 2)
+
+
+class testStats(unittest.TestCase):
+
+    def test_angle_stats(self):
+        angle.reset_stats()
+        angle.calc_angles(np.ones((10, 2)), np.ones((10, 2)))
+        stats = angle.stats()
+        if not angle.instrumented:
+            assert stats == {}
+            return
+        assert stats["calc_angles.calls"] == 1
+        assert stats["calc_angles.pairs"] == 10
+        assert stats["calc_angles.compute.ns"] <= stats["calc_angles.ns"]
+        angle.reset_stats()
+        assert angle.stats()["calc_angles.calls"] == 0
+
+    def test_line_stats(self):
+        _line.reset_stats()
+        _line.Line(5).copy()
+        stats = _line.stats()
+        if not _line.instrumented:
+            assert stats == {}
+            return
+        assert stats["line.copy"] == 1
+        assert stats["line.alloc.calls"] >= 2
+        assert stats["line.alloc.bytes"] >= 2 * 5 * 2 * 4
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Fixed set of worker threads running one chunked job at a time.  The caller
+ * takes part in its own job.  A caller that finds the pool busy runs its job
+ * alone rather than waiting, so concurrent callers never block each other.
+ * The first exception thrown by a chunk is rethrown in the caller.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t nworker)
+    {
+        for (size_t it = 0; it < nworker; ++it)
+            m_workers.emplace_back([this] { work(); });
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread &worker : m_workers)
+            worker.join();
+    }
+
+    size_t size() const { return m_workers.size() + 1; }
+
+    /* Call fn(chunk) for every chunk in [0, nchunk) */
+    void run(size_t nchunk, std::function<void(size_t)> const &fn)
+    {
+        std::unique_lock<std::mutex> busy(m_busy, std::try_to_lock);
+        if (!busy.owns_lock() || nchunk < 2 || m_workers.empty())
+        {
+            for (size_t it = 0; it < nchunk; ++it)
+                fn(it);
+            return;
+        }
+
+        size_t generation;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_fn = &fn;
+            m_nchunk = nchunk;
+            m_next = 0;
+            m_pending = nchunk;
+            m_error = nullptr;
+            generation = ++m_generation;
+        }
+        m_wake.notify_all();
+        drain(generation);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return 0 == m_pending; });
+        m_fn = nullptr;
+        if (m_error)
+            std::rethrow_exception(m_error);
+    }
+
+private:
+    /*
+     * Take chunks of job generation until none are left.  Chunks are few and
+     * large, so handing them out under the mutex costs nothing measurable and
+     * keeps a late worker from touching the next job's state.
+     */
+    void drain(size_t generation)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_generation == generation && m_next < m_nchunk)
+        {
+            size_t it = m_next++;
+            std::function<void(size_t)> const *fn = m_fn;
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                (*fn)(it);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+            if (error && !m_error)
+                m_error = error;
+            if (0 == --m_pending)
+                m_done.notify_all();
+        }
+    }
+
+    void work()
+    {
+        size_t seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+                if (m_stop)
+                    return;
+                seen = m_generation;
+            }
+            drain(seen);
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_busy;  // held by the caller owning the current job.
+    std::mutex m_mutex; // guards the job state below.
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::function<void(size_t)> const *m_fn = nullptr;
+    size_t m_nchunk = 0;
+    size_t m_next = 0;
+    size_t m_pending = 0;
+    size_t m_generation = 0;
+    std::exception_ptr m_error;
+    bool m_stop = false;
+}; /* end class ThreadPool */
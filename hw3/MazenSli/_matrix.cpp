@@ -0,0 +1,394 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/operators.h>
+#include <pybind11/stl.h>
+
+#include "batched.hpp"
+#include "dispatch.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
+#include "mapped_matrix.hpp"
+#include "matrix.hpp"
+#include "matrix_expr.hpp"
+#include "sparse.hpp"
+#include "strassen.hpp"
+
+namespace py = pybind11;
+
+/* Copy any 2-D array, whatever its strides and dtype, in one pass */
+template <typename T>
+BasicMatrix<T> matrix_from_numpy(py::array_t<T, py::array::forcecast> arr)
+{
+    if (arr.ndim() != 2)
+        throw std::invalid_argument("Matrix.from_numpy needs a 2-D array");
+
+    INSTRUMENT_TIME("convert.from_numpy");
+    auto src = arr.template unchecked<2>();
+    BasicMatrix<T> ret(arr.shape(0), arr.shape(1));
+    for (size_t it = 0; it < ret.nrow(); ++it)
+    {
+        T *row = ret.row(it);
+        for (size_t jt = 0; jt < ret.ncol(); ++jt)
+            row[jt] = src(it, jt);
+    }
+    return ret;
+}
+
+/* Rows or columns picked by one index: start, step and count */
+struct IndexRange
+{
+    size_t start;
+    ptrdiff_t step;
+    size_t count;
+    bool scalar; // an integer index rather than a slice
+};
+
+IndexRange index_range(py::handle idx, size_t n)
+{
+    if (py::isinstance<py::slice>(idx))
+    {
+        size_t start, stop, step, count;
+        if (!py::reinterpret_borrow<py::slice>(idx).compute(n, &start, &stop, &step, &count))
+            throw py::error_already_set();
+        return {start, static_cast<ptrdiff_t>(step), count, false};
+    }
+    ptrdiff_t it = idx.cast<ptrdiff_t>();
+    if (it < 0)
+        it += n;
+    if (it < 0 || static_cast<size_t>(it) >= n)
+        throw std::out_of_range("Matrix index out of range");
+    return {static_cast<size_t>(it), 1, 1, true};
+}
+
+/* Row and column of mat[i, j] for integer, possibly negative, i and j */
+std::pair<size_t, size_t> element_index(py::tuple idx, size_t nrow, size_t ncol)
+{
+    if (idx.size() != 2)
+        throw std::invalid_argument("Matrix index needs a row and a column");
+    IndexRange rows = index_range(idx[0], nrow);
+    IndexRange cols = index_range(idx[1], ncol);
+    if (!rows.scalar || !cols.scalar)
+        throw std::invalid_argument("Matrix element index must be two integers");
+    return {rows.start, cols.start};
+}
+
+/*
+ * mat[i, j] = value where i and j are integers or slices.  A number fills
+ * the whole selection; otherwise value must be an array of the selection's
+ * shape (1-D when one index is an integer).
+ */
+template <typename T>
+void matrix_setitem(BasicMatrix<T> &mat, py::tuple idx, py::object value)
+{
+    if (idx.size() != 2)
+        throw std::invalid_argument("Matrix index needs a row and a column");
+    INSTRUMENT_TIME("convert.setitem");
+    IndexRange rows = index_range(idx[0], mat.nrow());
+    IndexRange cols = index_range(idx[1], mat.ncol());
+
+    if (py::isinstance<py::float_>(value) || py::isinstance<py::int_>(value))
+    {
+        T v = value.cast<T>();
+        for (size_t it = 0; it < rows.count; ++it)
+        {
+            T *row = mat.row(rows.start + it * rows.step);
+            for (size_t jt = 0; jt < cols.count; ++jt)
+                row[cols.start + jt * cols.step] = v;
+        }
+        return;
+    }
+
+    auto arr = py::array_t<T, py::array::forcecast>::ensure(value);
+    if (!arr)
+        throw std::invalid_argument("Matrix values must be a number or an array");
+    std::vector<size_t> shape;
+    if (!rows.scalar)
+        shape.push_back(rows.count);
+    if (!cols.scalar)
+        shape.push_back(cols.count);
+    if (static_cast<size_t>(arr.ndim()) != shape.size()
+        || !std::equal(shape.begin(), shape.end(), arr.shape(),
+                       [](size_t a, py::ssize_t b) { return a == static_cast<size_t>(b); }))
+        throw std::invalid_argument("array shape does not match the Matrix selection");
+
+    // Element strides of the source along the selected rows and columns.
+    char const *src = static_cast<char const *>(arr.data());
+    ptrdiff_t rstride = rows.scalar ? 0 : arr.strides(0);
+    ptrdiff_t cstride = cols.scalar ? 0 : arr.strides(arr.ndim() - 1);
+    for (size_t it = 0; it < rows.count; ++it)
+    {
+        T *row = mat.row(rows.start + it * rows.step);
+        for (size_t jt = 0; jt < cols.count; ++jt)
+            row[cols.start + jt * cols.step] = *reinterpret_cast<T const *>(src + it * rstride + jt * cstride);
+    }
+}
+
+/*
+ * Matrix or FloatMatrix.  numpy.asarray(mat) is an (nrow, ncol) view of the
+ * matrix of its dtype; its row stride is ld() * sizeof(T) bytes.
+ */
+template <typename T>
+py::class_<BasicMatrix<T>> def_matrix(py::module &m, char const *name)
+{
+    using M = BasicMatrix<T>;
+    py::class_<M> cls(m, name, py::buffer_protocol());
+    cls.def(py::init<size_t, size_t>())
+        .def_buffer([](M &mat) -> py::buffer_info {
+            return py::buffer_info(
+                mat.data(), sizeof(T), py::format_descriptor<T>::format(), 2,
+                {mat.nrow(), mat.ncol()}, {sizeof(T) * mat.ld(), sizeof(T)});
+        })
+        .def_property_readonly("nrow", &M::nrow)
+        .def_property_readonly("ncol", &M::ncol)
+        .def_property_readonly("ld", &M::ld)
+        .def("__getitem__", [](M const &mat, py::tuple idx) {
+            std::pair<size_t, size_t> it = element_index(idx, mat.nrow(), mat.ncol());
+            return mat.at(it.first, it.second);
+        })
+        .def("__setitem__", &matrix_setitem<T>, "Set an element, or a row/column slice from a number or an array")
+        .def_static("from_numpy", &matrix_from_numpy<T>, "Copy a 2-D array into a new matrix")
+        .def("fill", &M::fill, "Set every element to value", py::arg("value"))
+        .def("iota", &M::iota, "Set element (i, j) to start + (i * ncol + j) * step",
+             py::arg("start") = 0.0, py::arg("step") = 1.0)
+        .def(py::self == py::self)
+        .def(py::self != py::self);
+    return cls;
+}
+
+/*
+ * Stacked products: a is (batch, m, k) and b (batch, k, n); the result is a
+ * new (batch, m, n) array.  Rows of either operand may be strided, but
+ * elements within a row must be contiguous, else the operand is copied.
+ */
+template <typename T, int Flags>
+py::array_t<T> multiply_batched(py::array_t<T, Flags> a, py::array_t<T, Flags> b, size_t nthread)
+{
+    if (a.ndim() != 3 || b.ndim() != 3)
+        throw std::invalid_argument("multiply_batched needs 3-D arrays");
+    if (a.shape(0) != b.shape(0) || a.shape(2) != b.shape(1))
+        throw std::out_of_range("the number and inner dimensions of the products differ");
+    for (auto *arr : {&a, &b})
+    {
+        bool inner = arr->shape(2) <= 1 || arr->strides(2) == py::ssize_t(sizeof(T));
+        bool aligned = arr->strides(0) % py::ssize_t(sizeof(T)) == 0 && arr->strides(1) % py::ssize_t(sizeof(T)) == 0
+                       && arr->strides(0) >= 0 && arr->strides(1) >= 0;
+        if (!inner || !aligned)
+        {
+            INSTRUMENT_TIME("convert.batched_copy");
+            *arr = py::array_t<T, Flags>(py::array_t<T, py::array::c_style | py::array::forcecast>::ensure(*arr));
+        }
+    }
+    py::array_t<T> ret({a.shape(0), a.shape(1), b.shape(2)});
+    size_t batch = a.shape(0), m = a.shape(1), k = a.shape(2), n = b.shape(2);
+    T const *pa = a.data(), *pb = b.data();
+    T *pc = ret.mutable_data();
+    {
+        py::gil_scoped_release release;
+        gemm_batched<T>(batch, m, n, k, pa, a.strides(1) / sizeof(T), a.strides(0) / sizeof(T),
+                        pb, b.strides(1) / sizeof(T), b.strides(0) / sizeof(T), pc, n, m * n, nthread);
+    }
+    return ret;
+}
+
+/*
+ * Lazy operators shared by Matrix and MatrixExpr: a * b and a @ b are the
+ * matrix product, number * a scales and a + b adds.  The result keeps its
+ * operands alive, since it refers to them.
+ */
+template <typename Class>
+void def_expr_operators(Class &cls)
+{
+    using T = typename Class::type;
+    auto mul = [](T const &lhs, MatrixExpr const &rhs) { return MatrixExpr(lhs) * rhs; };
+    auto mul_mat = [](T const &lhs, Matrix const &rhs) { return MatrixExpr(lhs) * rhs; };
+    auto scale = [](T const &expr, double s) { return s * MatrixExpr(expr); };
+    cls.def("__mul__", mul_mat, py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__mul__", mul, py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__mul__", scale, py::keep_alive<0, 1>())
+        .def("__rmul__", scale, py::keep_alive<0, 1>())
+        .def("__matmul__", mul_mat, py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__matmul__", mul, py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__add__", [](T const &lhs, Matrix const &rhs) { return MatrixExpr(lhs) + rhs; },
+             py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__add__", [](T const &lhs, MatrixExpr const &rhs) { return MatrixExpr(lhs) + rhs; },
+             py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__sub__", [](T const &lhs, Matrix const &rhs) { return MatrixExpr(lhs) - rhs; },
+             py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__sub__", [](T const &lhs, MatrixExpr const &rhs) { return MatrixExpr(lhs) - rhs; },
+             py::keep_alive<0, 1>(), py::keep_alive<0, 2>())
+        .def("__neg__", [](T const &expr) { return -MatrixExpr(expr); }, py::keep_alive<0, 1>());
+}
+
+/* expr.eval(out=None): into out, of the same shape, when given; out is returned */
+py::object expr_eval(MatrixExpr const &expr, py::object out, size_t nthread)
+{
+    if (out.is_none())
+    {
+        Matrix ret;
+        {
+            py::gil_scoped_release release;
+            expr.eval_into(ret, nthread);
+        }
+        return py::cast(std::move(ret));
+    }
+    // Numpy views of out must stay valid, so out is never reallocated.
+    Matrix &dest = out.cast<Matrix &>();
+    if (dest.nrow() != expr.nrow() || dest.ncol() != expr.ncol())
+        throw std::invalid_argument("out has a different shape from the expression");
+    {
+        py::gil_scoped_release release;
+        expr.eval_into(dest, nthread);
+    }
+    return out;
+}
+
+PYBIND11_MODULE(_matrix, m) {
+    m.doc() = "pybind11 matrix"; // optional module docstring
+
+    auto matrix = def_matrix<double>(m, "Matrix");
+    def_expr_operators(matrix);
+    // float32; only the naive, BLAS and tiled multiplies take it.
+    def_matrix<float>(m, "FloatMatrix");
+
+    py::class_<MatrixExpr> expr(m, "MatrixExpr",
+                                "Lazy sum of matrix products, built by the Matrix operators; eval() computes it");
+    expr.def_property_readonly("nrow", &MatrixExpr::nrow)
+        .def_property_readonly("ncol", &MatrixExpr::ncol)
+        .def("eval", &expr_eval,
+             "Compute the expression into a new Matrix, or into out of the same shape and return out",
+             py::arg("out") = py::none(), py::arg("nthread") = 0);
+    def_expr_operators(expr);
+
+    m.def("multiply_naive", py::overload_cast<Matrix const &, Matrix const &>(&multiply_naive),
+          "Triple-loop matrix-matrix multiplication");
+    m.def("multiply_naive", py::overload_cast<FloatMatrix const &, FloatMatrix const &>(&multiply_naive));
+    m.def("multiply_mkl", py::overload_cast<Matrix const &, Matrix const &>(&multiply_mkl),
+          "Matrix-matrix multiplication with BLAS DGEMM, or SGEMM for FloatMatrix");
+    m.def("multiply_mkl", py::overload_cast<FloatMatrix const &, FloatMatrix const &>(&multiply_mkl));
+    m.def("multiply_tile", [](Matrix const &mat1, Matrix const &mat2, size_t tsize, std::string const &order) {
+              return multiply_tile(mat1, mat2, tsize, loop_order(order));
+          },
+          "Cache-blocked matrix-matrix multiplication over tsize x tsize tiles; order is the loop order in a tile",
+          py::arg("mat1"), py::arg("mat2"), py::arg("tsize"), py::arg("order") = "ikj");
+    m.def("multiply_tile",
+          [](FloatMatrix const &mat1, FloatMatrix const &mat2, size_t tsize, std::string const &order) {
+              return multiply_tile(mat1, mat2, tsize, loop_order(order));
+          },
+          py::arg("mat1"), py::arg("mat2"), py::arg("tsize"), py::arg("order") = "ikj");
+    // Arrays numpy casts safely to float32 (float32 itself, small integers)
+    // give float32; anything else is converted to float64.
+    m.def("multiply_batched", &multiply_batched<float, 0>,
+          "Products of stacked (batch, m, k) and (batch, k, n) arrays, as a (batch, m, n) array",
+          py::arg("a"), py::arg("b"), py::arg("nthread") = 0);
+    m.def("multiply_batched", &multiply_batched<double, py::array::forcecast>, py::arg("a"), py::arg("b"),
+          py::arg("nthread") = 0);
+    m.def("multiply_parallel", &multiply_parallel,
+          "Tiled matrix-matrix multiplication on nthread threads (0: OMP_NUM_THREADS or every core)",
+          py::arg("mat1"), py::arg("mat2"), py::arg("nthread") = 0, py::arg("tsize") = 64,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("multiply_simd", &multiply_simd,
+          "Packed SIMD matrix-matrix multiplication on nthread threads (0: OMP_NUM_THREADS or every core)",
+          py::arg("mat1"), py::arg("mat2"), py::arg("nthread") = 0, py::call_guard<py::gil_scoped_release>());
+    m.def("multiply_strassen", &multiply_strassen,
+          "Strassen multiplication down to crossover, then multiply_simd (0: strassen_crossover())",
+          py::arg("mat1"), py::arg("mat2"), py::arg("nthread") = 0, py::arg("crossover") = 0,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("max_relative_error", &max_relative_error, "max |ret - ref| / max |ref| over the elements",
+          py::arg("ret"), py::arg("ref"));
+    m.def("strassen_crossover", &strassen_crossover, "Size below which multiply_strassen stops recursing");
+    m.def("set_strassen_crossover", &set_strassen_crossover, "Set the default multiply_strassen crossover",
+          py::arg("crossover"));
+
+    py::class_<StrassenTuning>(m, "StrassenTuning")
+        .def_readonly("crossover", &StrassenTuning::crossover)
+        .def_readonly("sizes", &StrassenTuning::sizes)
+        .def_readonly("gemm_seconds", &StrassenTuning::gemm_seconds)
+        .def_readonly("strassen_seconds", &StrassenTuning::strassen_seconds)
+        .def_readonly("max_error", &StrassenTuning::max_error);
+    m.def("tune_strassen", &tune_strassen,
+          "Time Strassen against multiply_simd up to max_size, set the crossover and report the error",
+          py::arg("max_size") = 2048, py::arg("nthread") = 0, py::call_guard<py::gil_scoped_release>());
+    m.def("multiply", &multiply,
+          "Matrix-matrix multiplication by the backend tuned for the shape and thread count; see multiply_backend",
+          py::arg("mat1"), py::arg("mat2"), py::arg("nthread") = 0, py::call_guard<py::gil_scoped_release>());
+    m.def("multiply_backend",
+          [](size_t m, size_t k, size_t n, size_t nthread) { return backend_name(multiply_backend(m, k, n, nthread)); },
+          "Name of the backend multiply() uses for an m x k times k x n product: mkl, simd or strassen",
+          py::arg("m"), py::arg("k"), py::arg("n"), py::arg("nthread") = 0);
+    m.def("tuning_path", &tuning_path, "File the multiply() tuning table is read from");
+    m.def("load_tuning", &load_tuning, "Use the tuning table in path; False if it is missing or for another CPU or thread count",
+          py::arg("path"));
+    m.def("save_tuning", &save_tuning, "Write the current tuning table to path", py::arg("path"));
+    m.def("tune_multiply", &tune_multiply, "Measure a new multiply() tuning table with shapes up to max_size",
+          py::arg("max_size") = 2048, py::call_guard<py::gil_scoped_release>());
+    py::class_<MappedMatrix>(m, "MappedMatrix", "Matrix in a memory-mapped file of tile x tile blocks")
+        .def_static("create", py::overload_cast<std::string const &, size_t, size_t, size_t>(&MappedMatrix::create),
+                    "A new zero matrix in path", py::arg("path"), py::arg("nrow"), py::arg("ncol"),
+                    py::arg("tile") = 512)
+        .def_static("create", py::overload_cast<std::string const &, Matrix const &, size_t>(&MappedMatrix::create),
+                    "A copy of mat in path", py::arg("path"), py::arg("mat"), py::arg("tile") = 512)
+        .def_static("open", &MappedMatrix::open, "An existing file", py::arg("path"), py::arg("writable") = false)
+        .def_property_readonly("nrow", &MappedMatrix::nrow)
+        .def_property_readonly("ncol", &MappedMatrix::ncol)
+        .def_property_readonly("tile", &MappedMatrix::tile)
+        .def_property_readonly("path", &MappedMatrix::path)
+        .def_property_readonly("writable", &MappedMatrix::writable)
+        .def("__getitem__", [](MappedMatrix const &mat, py::tuple idx) {
+            std::pair<size_t, size_t> it = element_index(idx, mat.nrow(), mat.ncol());
+            return mat.at(it.first, it.second);
+        })
+        .def("__setitem__", [](MappedMatrix &mat, py::tuple idx, double value) {
+            std::pair<size_t, size_t> it = element_index(idx, mat.nrow(), mat.ncol());
+            mat.at(it.first, it.second) = value;
+        })
+        .def("to_matrix", &MappedMatrix::to_matrix, "Copy into a Matrix")
+        .def("flush", &MappedMatrix::flush, "Write the changes to the file now");
+    m.def("multiply_out_of_core", &multiply_out_of_core,
+          "Multiply MappedMatrix operands block by block into a new MappedMatrix at path",
+          py::arg("mat1"), py::arg("mat2"), py::arg("path"), py::arg("nthread") = 0,
+          py::call_guard<py::gil_scoped_release>());
+    py::class_<SparseMatrix>(m, "SparseMatrix", "Sparse matrix in compressed sparse row form")
+        .def(py::init<Matrix const &>(), "The nonzeros of a Matrix", py::arg("mat"))
+        .def(py::init<size_t, size_t, std::vector<size_t>, std::vector<size_t>, std::vector<double>>(),
+             "From CSR arrays", py::arg("nrow"), py::arg("ncol"), py::arg("row_ptr"), py::arg("col_idx"),
+             py::arg("values"))
+        .def_property_readonly("nrow", &SparseMatrix::nrow)
+        .def_property_readonly("ncol", &SparseMatrix::ncol)
+        .def_property_readonly("nnz", &SparseMatrix::nnz)
+        .def_property_readonly("density", &SparseMatrix::density)
+        .def_property_readonly("row_ptr", &SparseMatrix::row_ptr)
+        .def_property_readonly("col_idx", &SparseMatrix::col_idx)
+        .def_property_readonly("values", &SparseMatrix::values)
+        .def("__getitem__", [](SparseMatrix const &mat, py::tuple idx) {
+            std::pair<size_t, size_t> it = element_index(idx, mat.nrow(), mat.ncol());
+            return mat.at(it.first, it.second);
+        })
+        .def("to_dense", &SparseMatrix::to_dense, "Copy into a Matrix");
+    m.def("multiply_sparse", &multiply_sparse,
+          "Sparse times dense matrix multiplication on nthread threads (0: OMP_NUM_THREADS or every core)",
+          py::arg("mat1"), py::arg("mat2"), py::arg("nthread") = 0, py::call_guard<py::gil_scoped_release>());
+    m.def("spmv",
+          [](SparseMatrix const &mat, py::array_t<double, py::array::c_style | py::array::forcecast> x,
+             size_t nthread) {
+              if (x.ndim() != 1 || size_t(x.shape(0)) != mat.ncol())
+                  throw std::out_of_range("the vector size differs from the number of matrix columns");
+              py::array_t<double> ret(mat.nrow());
+              double const *px = x.data();
+              double *out = ret.mutable_data();
+              {
+                  py::gil_scoped_release release;
+                  spmv(mat, px, out, nthread);
+              }
+              return ret;
+          },
+          "Sparse matrix times a 1-D array, as a new 1-D array", py::arg("mat"), py::arg("x"),
+          py::arg("nthread") = 0);
+    m.def("gemm_isa", &gemm_isa, "Instruction set used by multiply_simd");
+    m.def("set_gemm_isa", &set_gemm_isa, "Use \"avx512\", \"avx2\" or \"scalar\"; False if the CPU lacks it");
+
+    m.attr("instrumented") = instrument::enabled;
+    m.def("stats", &instrument::snapshot,
+          "Multiply and conversion timers since the last reset_stats(), over all threads; empty unless built with "
+          "INSTRUMENT=1");
+    m.def("reset_stats", &instrument::reset, "Count the instruments from zero again");
+}
@@ -0,0 +1,92 @@
+#include "batched.hpp"
+#include "instrument.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+/*
+ * c = a * b for compile-time sizes: every loop unrolls, and each output row
+ * is summed in registers before it is stored.
+ */
+template <typename T, size_t M, size_t N, size_t K>
+void small_kernel(T const *a, size_t lda, T const *b, size_t ldb, T *c, size_t ldc, size_t, size_t, size_t)
+{
+    for (size_t i = 0; i < M; ++i)
+    {
+        T acc[N] = {};
+        for (size_t p = 0; p < K; ++p)
+        {
+            T v = a[i * lda + p];
+            for (size_t j = 0; j < N; ++j)
+                acc[j] += v * b[p * ldb + j];
+        }
+        for (size_t j = 0; j < N; ++j)
+            c[i * ldc + j] = acc[j];
+    }
+}
+
+template <typename T>
+void generic_kernel(T const *a, size_t lda, T const *b, size_t ldb, T *c, size_t ldc, size_t m, size_t n, size_t k)
+{
+    for (size_t i = 0; i < m; ++i)
+    {
+        T *row = c + i * ldc;
+        std::fill(row, row + n, T(0));
+        for (size_t p = 0; p < k; ++p)
+        {
+            T v = a[i * lda + p];
+            for (size_t j = 0; j < n; ++j)
+                row[j] += v * b[p * ldb + j];
+        }
+    }
+}
+
+template <typename T>
+using Kernel = void (*)(T const *, size_t, T const *, size_t, T *, size_t, size_t, size_t, size_t);
+
+template <typename T>
+Kernel<T> pick_kernel(size_t m, size_t n, size_t k)
+{
+    if (m == n && n == k)
+    {
+        switch (m)
+        {
+        case 3: return &small_kernel<T, 3, 3, 3>;
+        case 4: return &small_kernel<T, 4, 4, 4>;
+        case 8: return &small_kernel<T, 8, 8, 8>;
+        }
+    }
+    return &generic_kernel<T>;
+}
+
+} /* end namespace */
+
+template <typename T>
+void gemm_batched(size_t batch, size_t m, size_t n, size_t k, T const *a, size_t lda, size_t stride_a,
+                  T const *b, size_t ldb, size_t stride_b, T *c, size_t ldc, size_t stride_c, size_t nthread)
+{
+    // Products are handed out in chunks, and threads only start for enough
+    // multiply-adds.
+    size_t const chunk = 1024;
+    size_t const parallel_grain = size_t(1) << 20;
+
+    INSTRUMENT_TIME("gemm_batched");
+    Kernel<T> kernel = pick_kernel<T>(m, n, k);
+    if (0 == nthread)
+    {
+        nthread = default_thread_count();
+    }
+    nthread = std::min(nthread, std::max<size_t>(batch * m * n * std::max<size_t>(k, 1) / parallel_grain, 1));
+    parallel_for((batch + chunk - 1) / chunk, nthread, [&](size_t it) {
+        for (size_t p = it * chunk; p < std::min(batch, (it + 1) * chunk); ++p)
+            kernel(a + p * stride_a, lda, b + p * stride_b, ldb, c + p * stride_c, ldc, m, n, k);
+    });
+}
+
+template void gemm_batched<float>(size_t, size_t, size_t, size_t, float const *, size_t, size_t, float const *,
+                                  size_t, size_t, float *, size_t, size_t, size_t);
+template void gemm_batched<double>(size_t, size_t, size_t, size_t, double const *, size_t, size_t, double const *,
+                                   size_t, size_t, double *, size_t, size_t, size_t);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * Strided batched multiply: c_p = a_p * b_p for every p in [0, batch), where
+ * a_p is the m x k block at a + p * stride_a with row stride lda, b_p the
+ * k x n block at b + p * stride_b and c_p the m x n block at c + p * stride_c
+ * (all in elements).  One call replaces batch calls for the many tiny
+ * products of geometry code.  The 3 x 3, 4 x 4 and 8 x 8 products run
+ * kernels specialized on the sizes at compile time, so their loops unroll
+ * fully and each output row is summed in registers; other sizes take a
+ * generic loop.  The batch is split over up to nthread threads (0 means
+ * default_thread_count()).  T is float or double; each element sums in T
+ * with k increasing, so the results equal multiply_naive's.
+ */
+template <typename T>
+void gemm_batched(size_t batch, size_t m, size_t n, size_t k, T const *a, size_t lda, size_t stride_a,
+                  T const *b, size_t ldb, size_t stride_b, T *c, size_t ldc, size_t stride_c, size_t nthread = 0);
@@ -0,0 +1,302 @@
+#include "dispatch.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
+#include "scheduler.hpp"
+#include "strassen.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+enum ShapeClass { tiny, small, medium, large, thin_k, thin_mn, nclass };
+
+char const *const class_names[nclass] = {"tiny", "small", "medium", "large", "thin_k", "thin_mn"};
+
+/* One m x k x n shape timed for each class by tune_multiply() */
+size_t const class_shapes[nclass][3] = {
+    {64, 64, 64}, {256, 256, 256}, {1024, 1024, 1024}, {2048, 2048, 2048}, {2048, 32, 2048}, {64, 2048, 64},
+};
+
+ShapeClass shape_class(size_t m, size_t k, size_t n)
+{
+    size_t lo = std::min({m, k, n}), hi = std::max({m, k, n});
+    if (hi >= 512 && 16 * lo < hi)
+    {
+        return k == lo ? thin_k : thin_mn;
+    }
+    double size = std::cbrt(double(m) * double(k) * double(n));
+    return size < 128 ? tiny : size < 512 ? small : size < 2048 ? medium : large;
+}
+
+/* Backends for every class, at one thread and at nthread threads */
+struct Table
+{
+    std::string cpu;
+    size_t nthread;
+    size_t crossover;
+    Backend backend[2][nclass];
+};
+
+// Tables only apply to the CPU and thread count they were measured on.
+std::string cpu_signature()
+{
+    return std::string(gemm_isa()) + "/" + std::to_string(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+Table default_table()
+{
+    Table ret{cpu_signature(), default_thread_count(), strassen_crossover(), {}};
+    for (auto &column : ret.backend)
+    {
+        std::fill(std::begin(column), std::end(column), Backend::simd);
+        column[large] = Backend::strassen;
+    }
+    return ret;
+}
+
+Table &table()
+{
+    static Table ret = default_table();
+    return ret;
+}
+
+bool read_table(std::string const &path);
+
+/* The table on disk, read on first use */
+void ensure_table()
+{
+    static std::once_flag flag;
+    std::call_once(flag, [] { read_table(tuning_path()); });
+}
+
+Matrix random_matrix(size_t nrow, size_t ncol, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix ret(nrow, ncol);
+    for (size_t it = 0; it < nrow; ++it)
+    {
+        for (size_t jt = 0; jt < ncol; ++jt)
+            ret(it, jt) = dist(rng);
+    }
+    return ret;
+}
+
+Matrix run_backend(Backend backend, Matrix const &mat1, Matrix const &mat2, size_t nthread)
+{
+    switch (backend)
+    {
+    case Backend::mkl: return multiply_mkl(mat1, mat2);
+    case Backend::strassen: return multiply_strassen(mat1, mat2, nthread);
+    default: return multiply_simd(mat1, mat2, nthread);
+    }
+}
+
+/* Best of three runs after a warm-up, in seconds */
+double best_time(Backend backend, Matrix const &mat1, Matrix const &mat2, size_t nthread)
+{
+    run_backend(backend, mat1, mat2, nthread);
+    double ret = HUGE_VAL;
+    for (size_t it = 0; it < 3; ++it)
+    {
+        auto start = std::chrono::steady_clock::now();
+        run_backend(backend, mat1, mat2, nthread);
+        ret = std::min(ret, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return ret;
+}
+
+void make_parent_dirs(std::string const &path)
+{
+    for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+    {
+        mkdir(path.substr(0, pos).c_str(), 0755); // existing directories are fine
+    }
+}
+
+/*
+ * The file is text:
+ *
+ *   matrix-tuning 1
+ *   cpu avx512/8
+ *   threads 8
+ *   strassen_crossover 512
+ *   tiny simd simd
+ *   ...
+ *
+ * with one line per class giving the one-thread and the threaded backend.
+ * The threaded column was timed at the thread count on the threads line, so
+ * a file is refused when that is not default_thread_count() any more.
+ */
+bool read_table(std::string const &path)
+{
+    std::ifstream in(path);
+    std::string word, version, cpu;
+    Table ret = default_table();
+    if (!(in >> word >> version) || "matrix-tuning" != word || "1" != version
+        || !(in >> word >> cpu) || "cpu" != word || cpu != ret.cpu
+        || !(in >> word >> ret.nthread) || "threads" != word || ret.nthread != default_thread_count()
+        || !(in >> word >> ret.crossover) || "strassen_crossover" != word || 0 == ret.crossover)
+    {
+        return false;
+    }
+    bool seen[nclass] = {};
+    std::string name, single, threaded;
+    while (in >> name >> single >> threaded)
+    {
+        auto found = std::find(std::begin(class_names), std::end(class_names), name);
+        if (std::end(class_names) == found)
+        {
+            return false;
+        }
+        size_t cls = found - std::begin(class_names);
+        try
+        {
+            ret.backend[0][cls] = backend_from_name(single);
+            ret.backend[1][cls] = backend_from_name(threaded);
+        }
+        catch (std::invalid_argument const &)
+        {
+            return false;
+        }
+        seen[cls] = true;
+    }
+    if (!in.eof() || std::count(std::begin(seen), std::end(seen), true) != nclass)
+    {
+        return false;
+    }
+    table() = ret;
+    set_strassen_crossover(ret.crossover);
+    return true;
+}
+
+} /* end namespace */
+
+char const *backend_name(Backend backend)
+{
+    switch (backend)
+    {
+    case Backend::mkl: return "mkl";
+    case Backend::strassen: return "strassen";
+    default: return "simd";
+    }
+}
+
+Backend backend_from_name(std::string const &name)
+{
+    for (Backend backend : {Backend::mkl, Backend::simd, Backend::strassen})
+    {
+        if (name == backend_name(backend))
+        {
+            return backend;
+        }
+    }
+    throw std::invalid_argument("unknown multiply backend: " + name);
+}
+
+Backend multiply_backend(size_t m, size_t k, size_t n, size_t nthread)
+{
+    ensure_table();
+    if (0 == nthread)
+    {
+        nthread = default_thread_count();
+    }
+    return table().backend[nthread > 1 ? 1 : 0][shape_class(m, k, n)];
+}
+
+Matrix multiply(Matrix const &mat1, Matrix const &mat2, size_t nthread)
+{
+    INSTRUMENT_TIME("multiply");
+    return run_backend(multiply_backend(mat1.nrow(), mat1.ncol(), mat2.ncol(), nthread), mat1, mat2, nthread);
+}
+
+std::string tuning_path()
+{
+    if (char const *env = std::getenv("MATRIX_TUNING"))
+    {
+        return env;
+    }
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    char const *home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.cache/nsdhw_matrix/" + host + ".tuning";
+}
+
+bool load_tuning(std::string const &path)
+{
+    ensure_table();
+    return read_table(path);
+}
+
+void save_tuning(std::string const &path)
+{
+    ensure_table();
+    make_parent_dirs(path);
+    std::ofstream out(path);
+    Table const &tab = table();
+    out << "matrix-tuning 1\ncpu " << tab.cpu << "\nthreads " << tab.nthread << "\nstrassen_crossover "
+        << tab.crossover << "\n";
+    for (size_t cls = 0; cls < nclass; ++cls)
+    {
+        out << class_names[cls] << " " << backend_name(tab.backend[0][cls]) << " "
+            << backend_name(tab.backend[1][cls]) << "\n";
+    }
+    if (!out.flush())
+    {
+        throw std::runtime_error("cannot write tuning table " + path);
+    }
+}
+
+void tune_multiply(size_t max_size)
+{
+    ensure_table();
+    Table ret = default_table();
+    ret.crossover = tune_strassen(max_size, ret.nthread).crossover;
+
+    std::mt19937 rng(0);
+    for (size_t cls = 0; cls < nclass; ++cls)
+    {
+        size_t const *shape = class_shapes[cls];
+        if (std::max({shape[0], shape[1], shape[2]}) > max_size)
+        {
+            continue; // keeps the default
+        }
+        Matrix mat1 = random_matrix(shape[0], shape[1], rng), mat2 = random_matrix(shape[1], shape[2], rng);
+        std::vector<Backend> candidates = {Backend::mkl, Backend::simd};
+        if (std::min({shape[0], shape[1], shape[2]}) > ret.crossover)
+        {
+            candidates.push_back(Backend::strassen); // otherwise the same as simd
+        }
+        for (size_t col = 0; col < 2; ++col)
+        {
+            if (1 == col && 1 == ret.nthread)
+            {
+                ret.backend[1][cls] = ret.backend[0][cls];
+                break;
+            }
+            size_t nthread = 0 == col ? 1 : ret.nthread;
+            double best = HUGE_VAL;
+            for (Backend backend : candidates)
+            {
+                double seconds = best_time(backend, mat1, mat2, nthread);
+                if (seconds < best)
+                {
+                    best = seconds;
+                    ret.backend[col][cls] = backend;
+                }
+            }
+        }
+    }
+    table() = ret;
+}
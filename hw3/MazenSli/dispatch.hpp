@@ -0,0 +1,44 @@
+#pragma once
+
+#include "matrix.hpp"
+
+#include <string>
+
+/*
+ * multiply() picks a backend by the shape of the product and the thread
+ * budget, from a tuning table measured once per host.  The candidates are
+ * multiply_mkl, multiply_simd (on the best instruction set of the CPU) and
+ * multiply_strassen (with the tuned crossover); multiply_naive and
+ * multiply_tile never beat multiply_simd, so they are not.
+ *
+ * Shapes fall into classes: tiny, small, medium and large by the cube root
+ * of m k n, and thin_k or thin_mn when the smallest dimension, k or one of m
+ * and n, is under a sixteenth of the largest.  The table holds a backend for
+ * every class at one thread and at default_thread_count() threads.
+ *
+ * The first multiply() loads the table from tuning_path(); it never tunes.
+ * Without a table for this CPU and thread count it uses built-in defaults: multiply_strassen
+ * for large shapes and multiply_simd otherwise.  tune_multiply() measures a
+ * new table, and save_tuning() writes it; "matrix_bench --tune" does both.
+ * Loading and tuning must not run concurrently with multiply().
+ */
+enum class Backend { mkl, simd, strassen };
+
+char const *backend_name(Backend backend);
+Backend backend_from_name(std::string const &name); // throws std::invalid_argument.
+
+// The backend multiply() uses for an m x k times k x n product (nthread = 0
+// means default_thread_count()).
+Backend multiply_backend(size_t m, size_t k, size_t n, size_t nthread = 0);
+Matrix multiply(Matrix const &mat1, Matrix const &mat2, size_t nthread = 0);
+
+// $MATRIX_TUNING if set, else ~/.cache/nsdhw_matrix/<hostname>.tuning.
+std::string tuning_path();
+// Replace the table with the one in path; false, keeping the current
+// table, if the file is missing, malformed or measured on another CPU or
+// at another default_thread_count().
+bool load_tuning(std::string const &path);
+void save_tuning(std::string const &path); // throws std::runtime_error.
+// Time the candidates on one shape per class, up to max_size, and make the
+// result the table.  Also tunes the Strassen crossover.
+void tune_multiply(size_t max_size = 2048);
@@ -0,0 +1,178 @@
+#include "gemm.hpp"
+#include "gemm_simd.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+
+/* Plain traits for CPUs without the vector kernels */
+struct Scalar
+{
+    using reg = double;
+    static constexpr size_t width = 1;
+    static constexpr size_t mr = 4;
+    static constexpr size_t nreg = 4;
+    static constexpr size_t mc = 64;
+    static constexpr size_t kc = 256;
+    static constexpr size_t nc = 1024;
+
+    static reg zero() { return 0; }
+    static reg load(double const *p) { return *p; }
+    static reg loadu(double const *p) { return *p; }
+    static void store(double *p, reg v) { *p = v; }
+    static void storeu(double *p, reg v) { *p = v; }
+    static reg set1(double a) { return a; }
+    static reg add(reg a, reg b) { return a + b; }
+    static reg mul(reg a, reg b) { return a * b; }
+    static reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+}; /* end struct Scalar */
+
+GemmKernelTable const *default_kernels()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return &gemm_kernels_avx512();
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return &gemm_kernels_avx2();
+    }
+#endif
+    return &gemm_kernels_scalar();
+}
+
+GemmKernelTable const *&active_kernels()
+{
+    static GemmKernelTable const *ret = default_kernels();
+    return ret;
+}
+
+GemmKernelTable const &kernels() { return *active_kernels(); }
+
+/* Grow-only 64-byte aligned scratch array */
+class PackBuffer
+{
+public:
+    PackBuffer() = default;
+    PackBuffer(PackBuffer const &) = delete;
+    PackBuffer &operator=(PackBuffer const &) = delete;
+    ~PackBuffer() { std::free(m_data); }
+
+    double *get(size_t size)
+    {
+        if (size > m_size)
+        {
+            std::free(m_data);
+            m_data = static_cast<double *>(std::aligned_alloc(64, (size * sizeof(double) + 63) / 64 * 64));
+            m_size = m_data ? size : 0;
+            if (!m_data)
+            {
+                throw std::bad_alloc();
+            }
+        }
+        return m_data;
+    }
+
+private:
+    double *m_data = nullptr;
+    size_t m_size = 0;
+}; /* end class PackBuffer */
+
+// Each thread packs its own blocks of a; only the calling thread packs b.
+thread_local PackBuffer pack_a_buffer;
+thread_local PackBuffer pack_b_buffer;
+
+} /* end namespace */
+
+GemmKernelTable const &gemm_kernels_scalar() { return PackedGemm<Scalar>::table("scalar"); }
+
+void gemm(size_t m, size_t n, size_t k, double const *a, size_t lda, double const *b, size_t ldb,
+          double *c, size_t ldc, size_t nthread)
+{
+    gemm(m, n, k, 1.0, a, lda, b, ldb, 0.0, c, ldc, nthread);
+}
+
+void gemm(size_t m, size_t n, size_t k, double alpha, double const *a, size_t lda, double const *b, size_t ldb,
+          double beta, double *c, size_t ldc, size_t nthread)
+{
+    GemmKernelTable const &kt = kernels();
+    if (0 == k)
+    {
+        for (size_t i = 0; i < m; ++i)
+        {
+            double *row = c + i * ldc;
+            for (size_t j = 0; j < n; ++j)
+            {
+                row[j] = 0 == beta ? 0 : beta * row[j];
+            }
+        }
+        return;
+    }
+    // Below this many multiply-adds per thread, thread start-up dominates.
+    size_t const parallel_grain = size_t(1) << 22;
+    if (0 == nthread)
+    {
+        nthread = default_thread_count();
+    }
+    nthread = std::min(nthread, std::max<size_t>(m * n * k / parallel_grain, 1));
+
+    size_t nbp = (std::min(kt.nc, n) + kt.nr - 1) / kt.nr * kt.nr * std::min(kt.kc, k);
+    double *bp = pack_b_buffer.get(nbp);
+    size_t nblock = (m + kt.mc - 1) / kt.mc;
+    for (size_t jc = 0; jc < n; jc += kt.nc)
+    {
+        size_t nc = std::min(kt.nc, n - jc);
+        for (size_t pc = 0; pc < k; pc += kt.kc)
+        {
+            size_t kc = std::min(kt.kc, k - pc);
+            kt.pack_b(b + pc * ldb + jc, ldb, kc, nc, bp);
+            parallel_for(nblock, nthread, [&](size_t it) {
+                size_t ic = it * kt.mc;
+                size_t mc = std::min(kt.mc, m - ic);
+                double *ap = pack_a_buffer.get(kt.mc * kt.kc);
+                kt.pack_a(a + ic * lda + pc, lda, mc, kc, ap);
+                kt.macro_kernel(ap, bp, mc, nc, kc, alpha, 0 == pc ? beta : 1.0, c + ic * ldc + jc, ldc);
+            });
+        }
+    }
+}
+
+char const *gemm_isa() { return kernels().name; }
+
+bool set_gemm_isa(char const *name)
+{
+    GemmKernelTable const *table = nullptr;
+    if (0 == std::strcmp(name, "scalar"))
+    {
+        table = &gemm_kernels_scalar();
+    }
+#if defined(__x86_64__) || defined(_M_X64)
+    else if (0 == std::strcmp(name, "avx2"))
+    {
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            table = &gemm_kernels_avx2();
+        }
+    }
+    else if (0 == std::strcmp(name, "avx512"))
+    {
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            table = &gemm_kernels_avx512();
+        }
+    }
+#endif
+    if (!table)
+    {
+        return false;
+    }
+    active_kernels() = table;
+    return true;
+}
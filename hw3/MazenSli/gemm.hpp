@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * c = a * b for row-major blocks: a is m x k, b is k x n and c is m x n, with
+ * row strides lda, ldb and ldc.  GotoBLAS-style: blocks of a and b are packed
+ * into aligned panels and an FMA micro-kernel keeps an mr x nr tile of c in
+ * registers.  The blocks of mc rows run on up to nthread threads (0 means
+ * default_thread_count()).  Sums are reordered, so results differ from
+ * multiply_naive by rounding (not for integers small enough to sum exactly).
+ *
+ * Target: at least 75% of multiply_mkl's single-thread speed at 1000 x 1000.
+ */
+void gemm(size_t m, size_t n, size_t k, double const *a, size_t lda, double const *b, size_t ldb,
+          double *c, size_t ldc, size_t nthread = 0);
+
+// c = alpha * a * b + beta * c, folded into the micro-kernel's stores.  c is
+// not read when beta is 0, as in BLAS.
+void gemm(size_t m, size_t n, size_t k, double alpha, double const *a, size_t lda, double const *b, size_t ldb,
+          double beta, double *c, size_t ldc, size_t nthread = 0);
+
+// Instruction set selection: "avx512", "avx2" or "scalar".  The best one the
+// CPU supports is picked at start-up.
+char const *gemm_isa();
+bool set_gemm_isa(char const *name); // false if unknown or the CPU lacks it.
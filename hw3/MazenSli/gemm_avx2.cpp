@@ -0,0 +1,41 @@
+/*
+ * AVX2 GEMM kernels.  This file alone is compiled with -mavx2 -mfma and is
+ * only called after the CPU check in gemm.cpp.
+ */
+
+#include "gemm_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+namespace
+{
+
+/* 6 x 8 micro-tile: 12 accumulators, 2 B registers and 1 broadcast */
+struct Avx2
+{
+    using reg = __m256d;
+    static constexpr size_t width = 4;
+    static constexpr size_t mr = 6;
+    static constexpr size_t nreg = 2;
+    static constexpr size_t mc = 96;
+    static constexpr size_t kc = 256;
+    static constexpr size_t nc = 2048;
+
+    static reg zero() { return _mm256_setzero_pd(); }
+    static reg load(double const *p) { return _mm256_load_pd(p); }
+    static reg loadu(double const *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm256_store_pd(p, v); }
+    static void storeu(double *p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg set1(double a) { return _mm256_set1_pd(a); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+}; /* end struct Avx2 */
+
+} /* end namespace */
+
+GemmKernelTable const &gemm_kernels_avx2() { return PackedGemm<Avx2>::table("avx2"); }
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * AVX-512 GEMM kernels.  This file alone is compiled with -mavx512f and is
+ * only called after the CPU check in gemm.cpp.
+ */
+
+#include "gemm_simd.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#include <immintrin.h>
+
+namespace
+{
+
+/* 12 x 16 micro-tile: 24 accumulators, 2 B registers and 1 broadcast */
+struct Avx512
+{
+    using reg = __m512d;
+    static constexpr size_t width = 8;
+    static constexpr size_t mr = 12;
+    static constexpr size_t nreg = 2;
+    static constexpr size_t mc = 96;
+    static constexpr size_t kc = 256;
+    static constexpr size_t nc = 2048;
+
+    static reg zero() { return _mm512_setzero_pd(); }
+    static reg load(double const *p) { return _mm512_load_pd(p); }
+    static reg loadu(double const *p) { return _mm512_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm512_store_pd(p, v); }
+    static void storeu(double *p, reg v) { _mm512_storeu_pd(p, v); }
+    static reg set1(double a) { return _mm512_set1_pd(a); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+}; /* end struct Avx512 */
+
+} /* end namespace */
+
+GemmKernelTable const &gemm_kernels_avx512() { return PackedGemm<Avx512>::table("avx512"); }
+
+#endif
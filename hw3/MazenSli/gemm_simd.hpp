@@ -0,0 +1,172 @@
+#pragma once
+
+/*
+ * Internals of gemm(): the per-instruction-set kernel table and the packing
+ * and micro-kernel code written once over a vector-traits type.  Each
+ * instruction set is instantiated in its own translation unit with traits in
+ * an anonymous namespace, so the instantiations never merge across compiler
+ * flags.  For the same reason this code calls no C++ inline functions; the
+ * loops, threads and buffers live in gemm.cpp, built with baseline flags.
+ */
+
+#include <stddef.h>
+
+/*
+ * Packed-panel kernels for the GotoBLAS blocking in gemm.cpp.  A block of
+ * A (mc x kc) is packed into panels of mr rows, a block of B (kc x nc) into
+ * panels of nr columns; each panel stores its k-th column (row) of mr (nr)
+ * values contiguously, padded with zeros.  The macro kernel then runs the
+ * mr x nr register-blocked micro-kernel over every pair of panels.
+ */
+struct GemmKernelTable
+{
+    char const *name;
+    size_t mr, nr;     // micro-tile
+    size_t mc, kc, nc; // cache blocks; mc is a multiple of mr, nc of nr
+    void (*pack_a)(double const *a, size_t lda, size_t mc, size_t kc, double *ap);
+    void (*pack_b)(double const *b, size_t ldb, size_t kc, size_t nc, double *bp);
+    // c (mc x nc, row stride ldc) = alpha * packed A * packed B + beta * c;
+    // c is not read when beta is 0.
+    void (*macro_kernel)(double const *ap, double const *bp, size_t mc, size_t nc, size_t kc,
+                         double alpha, double beta, double *c, size_t ldc);
+};
+
+GemmKernelTable const &gemm_kernels_scalar();
+#if defined(__x86_64__) || defined(_M_X64)
+GemmKernelTable const &gemm_kernels_avx2();
+GemmKernelTable const &gemm_kernels_avx512();
+#endif
+
+/*
+ * Kernels over a traits type V providing a double register V::reg of
+ * V::width lanes, the micro-tile height V::mr and width V::nreg registers,
+ * and the cache blocks V::mc, V::kc and V::nc.
+ */
+template <typename V>
+struct PackedGemm
+{
+    using reg = typename V::reg;
+    static constexpr size_t W = V::width;
+    static constexpr size_t MR = V::mr;
+    static constexpr size_t NV = V::nreg;
+    static constexpr size_t NR = NV * W;
+
+    static size_t min(size_t a, size_t b) { return a < b ? a : b; }
+
+    static void pack_a(double const *a, size_t lda, size_t mc, size_t kc, double *ap)
+    {
+        for (size_t i0 = 0; i0 < mc; i0 += MR)
+        {
+            size_t mr = min(MR, mc - i0);
+            for (size_t p = 0; p < kc; ++p)
+            {
+                for (size_t i = 0; i < MR; ++i)
+                {
+                    ap[i] = i < mr ? a[(i0 + i) * lda + p] : 0;
+                }
+                ap += MR;
+            }
+        }
+    }
+
+    static void pack_b(double const *b, size_t ldb, size_t kc, size_t nc, double *bp)
+    {
+        for (size_t j0 = 0; j0 < nc; j0 += NR)
+        {
+            size_t nr = min(NR, nc - j0);
+            for (size_t p = 0; p < kc; ++p)
+            {
+                double const *row = b + p * ldb + j0;
+                for (size_t j = 0; j < NR; ++j)
+                {
+                    bp[j] = j < nr ? row[j] : 0;
+                }
+                bp += NR;
+            }
+        }
+    }
+
+    /* One mr x nr tile of c from an A panel and a B panel */
+    static void micro_kernel(size_t kc, double const *ap, double const *bp, double alpha, double beta,
+                             double *c, size_t ldc, size_t mr, size_t nr)
+    {
+        // The fixed trip counts unroll fully, so acc lives in registers.
+        reg acc[MR][NV];
+        for (size_t i = 0; i < MR; ++i)
+        {
+            for (size_t v = 0; v < NV; ++v)
+            {
+                acc[i][v] = V::zero();
+            }
+        }
+        for (size_t p = 0; p < kc; ++p)
+        {
+            reg b[NV];
+            for (size_t v = 0; v < NV; ++v)
+            {
+                b[v] = V::load(bp + v * W);
+            }
+            for (size_t i = 0; i < MR; ++i)
+            {
+                reg a = V::set1(ap[i]);
+                for (size_t v = 0; v < NV; ++v)
+                {
+                    acc[i][v] = V::fmadd(a, b[v], acc[i][v]);
+                }
+            }
+            ap += MR;
+            bp += NR;
+        }
+
+        if (MR == mr && NR == nr)
+        {
+            reg va = V::set1(alpha), vb = V::set1(beta);
+            for (size_t i = 0; i < MR; ++i)
+            {
+                for (size_t v = 0; v < NV; ++v)
+                {
+                    double *p = c + i * ldc + v * W;
+                    reg ab = V::mul(va, acc[i][v]);
+                    V::storeu(p, 0 == beta ? ab : V::fmadd(vb, V::loadu(p), ab));
+                }
+            }
+            return;
+        }
+        // Edge tile: spill and copy the valid part.
+        alignas(64) double tmp[MR * NR];
+        for (size_t i = 0; i < MR; ++i)
+        {
+            for (size_t v = 0; v < NV; ++v)
+            {
+                V::store(tmp + i * NR + v * W, acc[i][v]);
+            }
+        }
+        for (size_t i = 0; i < mr; ++i)
+        {
+            for (size_t j = 0; j < nr; ++j)
+            {
+                double ab = alpha * tmp[i * NR + j];
+                c[i * ldc + j] = 0 == beta ? ab : beta * c[i * ldc + j] + ab;
+            }
+        }
+    }
+
+    static void macro_kernel(double const *ap, double const *bp, size_t mc, size_t nc, size_t kc,
+                             double alpha, double beta, double *c, size_t ldc)
+    {
+        for (size_t j0 = 0; j0 < nc; j0 += NR)
+        {
+            for (size_t i0 = 0; i0 < mc; i0 += MR)
+            {
+                micro_kernel(kc, ap + i0 * kc, bp + j0 * kc, alpha, beta, c + i0 * ldc + j0, ldc,
+                             min(MR, mc - i0), min(NR, nc - j0));
+            }
+        }
+    }
+
+    static GemmKernelTable const &table(char const *name)
+    {
+        static GemmKernelTable const ret = {name, MR, NR, V::mc, V::kc, V::nc, &pack_a, &pack_b, &macro_kernel};
+        return ret;
+    }
+}; /* end struct PackedGemm */
@@ -0,0 +1,96 @@
+#include "instrument.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace instrument
+{
+
+namespace
+{
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<ThreadCounters const *> threads; // alive
+    uint64_t retired[max_counters] = {};         // from threads that exited
+    uint64_t baseline[max_counters] = {};        // totals at the last reset()
+};
+
+// Never destroyed: threads, the scheduler's detached workers among them, can
+// outlive the static destructors.
+Registry &registry()
+{
+    static Registry *ret = new Registry;
+    return *ret;
+}
+
+/* Sum of every thread's copies, under the registry lock */
+void totals(Registry const &reg, uint64_t *out)
+{
+    std::copy(std::begin(reg.retired), std::end(reg.retired), out);
+    for (ThreadCounters const *counters : reg.threads)
+    {
+        for (size_t it = 0; it < reg.names.size(); ++it)
+            out[it] += counters->value[it].load(std::memory_order_relaxed);
+    }
+}
+
+} /* end namespace */
+
+ThreadCounters::ThreadCounters()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.push_back(this);
+}
+
+ThreadCounters::~ThreadCounters()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (size_t it = 0; it < max_counters; ++it)
+        reg.retired[it] += value[it].load(std::memory_order_relaxed);
+    reg.threads.erase(std::find(reg.threads.begin(), reg.threads.end(), this));
+}
+
+size_t counter_slot(std::string const &name)
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    auto found = std::find(reg.names.begin(), reg.names.end(), name);
+    if (found != reg.names.end())
+    {
+        return found - reg.names.begin();
+    }
+    if (reg.names.size() == max_counters)
+    {
+        throw std::length_error("too many instrument counters");
+    }
+    reg.names.push_back(name);
+    return reg.names.size() - 1;
+}
+
+std::map<std::string, uint64_t> snapshot()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    uint64_t sum[max_counters];
+    totals(reg, sum);
+    std::map<std::string, uint64_t> ret;
+    for (size_t it = 0; it < reg.names.size(); ++it)
+        ret[reg.names[it]] = sum[it] - reg.baseline[it];
+    return ret;
+}
+
+void reset()
+{
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    totals(reg, reg.baseline);
+}
+
+} /* end namespace instrument */
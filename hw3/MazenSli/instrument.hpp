@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+/*
+ * Timers for the matrix library, compiled in with -DMATRIX_INSTRUMENT (make
+ * INSTRUMENT=1).  Every multiply backend times itself under its own name, as
+ * do multiply() and the numpy conversions (convert.*); matrix_bench prints
+ * the totals and _matrix.stats() returns them.  Without the macro
+ * INSTRUMENT_TIME expands to nothing and snapshot() is empty.
+ *
+ * The scheduler's workers record into per-thread copies of every counter
+ * with relaxed stores, so timing a threaded multiply adds no shared cache
+ * line to it.  snapshot() sums the copies of live and exited threads;
+ * reset() keeps the copies and stores a baseline to subtract instead.  A
+ * timer is the pair <name>.calls and <name>.ns (steady_clock nanoseconds).
+ */
+namespace instrument
+{
+
+#ifdef MATRIX_INSTRUMENT
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+size_t const max_counters = 128;
+
+/* The copies of every counter that belong to one thread */
+struct ThreadCounters
+{
+    ThreadCounters();
+    ThreadCounters(ThreadCounters const &) = delete;
+    ThreadCounters &operator=(ThreadCounters const &) = delete;
+    ~ThreadCounters();
+
+    std::atomic<uint64_t> value[max_counters] = {};
+}; /* end struct ThreadCounters */
+
+inline ThreadCounters &thread_counters()
+{
+    thread_local ThreadCounters ret;
+    return ret;
+}
+
+// The slot of the named counter, added on first use (throws
+// std::length_error past max_counters).  Equal names share a slot.
+size_t counter_slot(std::string const &name);
+
+class Counter
+{
+public:
+    explicit Counter(std::string const &name) : m_slot(counter_slot(name)) {}
+
+    void add(uint64_t n = 1) const
+    {
+        std::atomic<uint64_t> &value = thread_counters().value[m_slot];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+private:
+    size_t m_slot;
+}; /* end class Counter */
+
+class Timer
+{
+public:
+    explicit Timer(std::string const &name) : m_calls(name + ".calls"), m_ns(name + ".ns") {}
+
+    /* Times its own lifetime */
+    class Scope
+    {
+    public:
+        explicit Scope(Timer const &timer) : m_timer(timer), m_start(std::chrono::steady_clock::now()) {}
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+        ~Scope()
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+            m_timer.m_calls.add();
+            m_timer.m_ns.add(ns.count());
+        }
+
+    private:
+        Timer const &m_timer;
+        std::chrono::steady_clock::time_point m_start;
+    }; /* end class Scope */
+
+private:
+    Counter m_calls;
+    Counter m_ns;
+}; /* end class Timer */
+
+// Counter name to value since the last reset(), over all threads.
+std::map<std::string, uint64_t> snapshot();
+void reset();
+
+} /* end namespace instrument */
+
+#define INSTRUMENT_CAT_(a, b) a##b
+#define INSTRUMENT_CAT(a, b) INSTRUMENT_CAT_(a, b)
+
+#ifdef MATRIX_INSTRUMENT
+// Add n to the named counter.
+#define INSTRUMENT_COUNT(name, n)                                                                                      \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static ::instrument::Counter const instrument_counter(name);                                                   \
+        instrument_counter.add(n);                                                                                     \
+    } while (0)
+// Time the rest of the enclosing block.
+#define INSTRUMENT_TIME(name)                                                                                          \
+    static ::instrument::Timer const INSTRUMENT_CAT(instrument_timer_, __LINE__)(name);                                \
+    ::instrument::Timer::Scope INSTRUMENT_CAT(instrument_scope_, __LINE__)(INSTRUMENT_CAT(instrument_timer_, __LINE__))
+#else
+#define INSTRUMENT_COUNT(name, n) ((void)0)
+#define INSTRUMENT_TIME(name) ((void)0)
+#endif
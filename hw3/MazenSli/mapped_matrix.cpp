@@ -0,0 +1,366 @@
+#include "mapped_matrix.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+/* First bytes of the file; the blocks start at header_size */
+struct Header
+{
+    char magic[8];
+    uint64_t nrow;
+    uint64_t ncol;
+    uint64_t tile;
+};
+
+char const file_magic[8] = {'N', 'S', 'D', 'H', 'W', 'M', 'M', '1'};
+size_t const header_size = 4096;
+
+[[noreturn]] void fail(std::string const &what, std::string const &path)
+{
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+/* Bytes in the file of such a matrix; false if that overflows a size_t */
+bool file_length(size_t nrow, size_t ncol, size_t tile, size_t &length)
+{
+    size_t nblock, block;
+    return !__builtin_mul_overflow(nrow / tile + (nrow % tile != 0), ncol / tile + (ncol % tile != 0), &nblock)
+           && !__builtin_mul_overflow(tile, tile, &block) && !__builtin_mul_overflow(block, sizeof(double), &block)
+           && !__builtin_mul_overflow(nblock, block, &length) && !__builtin_add_overflow(length, header_size, &length);
+}
+
+/* Rows or columns in block it of a dimension of size total */
+size_t block_size(size_t total, size_t tile, size_t it) { return std::min(tile, total - it * tile); }
+
+/* The nrow x ncol corner of a block into dest */
+void load_block(Matrix &dest, double const *block, size_t nrow, size_t ncol, size_t tile)
+{
+    for (size_t it = 0; it < nrow; ++it)
+        std::copy_n(block + it * tile, ncol, dest.row(it));
+}
+
+/* Start the kernel reading a block in, without waiting for it */
+void will_need(double const *block, size_t tile)
+{
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = reinterpret_cast<uintptr_t>(block) / page * page;
+    uintptr_t end = reinterpret_cast<uintptr_t>(block + tile * tile);
+    madvise(reinterpret_cast<void *>(begin), end - begin, MADV_WILLNEED);
+}
+
+void store_block(double *block, Matrix const &src, size_t nrow, size_t ncol, size_t tile)
+{
+    for (size_t it = 0; it < nrow; ++it)
+        std::copy_n(src.row(it), ncol, block + it * tile);
+}
+
+/* One background thread for a whole multiply, running fn(step) on request */
+class Prefetcher
+{
+public:
+    explicit Prefetcher(std::function<void(size_t)> fn) : m_fn(std::move(fn))
+    {
+        m_thread = std::thread(&Prefetcher::loop, this);
+    }
+    Prefetcher(Prefetcher const &) = delete;
+    Prefetcher &operator=(Prefetcher const &) = delete;
+
+    ~Prefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    void start(size_t step)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_step = step;
+            m_requested = true;
+        }
+        m_wake.notify_all();
+    }
+
+    /* Wait for the started step; rethrows what it threw */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return !m_requested; });
+        if (m_error)
+        {
+            std::rethrow_exception(std::exchange(m_error, nullptr));
+        }
+    }
+
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_wake.wait(lock, [this] { return m_stop || m_requested; });
+            if (m_stop)
+            {
+                return;
+            }
+            lock.unlock();
+            std::exception_ptr error;
+            try
+            {
+                m_fn(m_step);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            lock.lock();
+            m_error = error;
+            m_requested = false;
+            m_wake.notify_all();
+        }
+    }
+
+    std::function<void(size_t)> m_fn;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    size_t m_step = 0;
+    bool m_requested = false;
+    bool m_stop = false;
+    std::exception_ptr m_error;
+    std::thread m_thread;
+}; /* end class Prefetcher */
+
+} /* end namespace */
+
+MappedMatrix MappedMatrix::create(std::string const &path, size_t nrow, size_t ncol, size_t tile)
+{
+    if (0 == tile)
+    {
+        throw std::invalid_argument("tile size must be positive");
+    }
+    size_t length;
+    if (!file_length(nrow, ncol, tile, length))
+    {
+        throw std::invalid_argument("MappedMatrix is too large");
+    }
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        fail("cannot create", path);
+    }
+    Header header{{}, nrow, ncol, tile};
+    std::copy(std::begin(file_magic), std::end(file_magic), header.magic);
+    // The file is sparse: the blocks read as zeros until written.
+    if (pwrite(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header))
+        || ftruncate(fd, length) != 0)
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        fail("cannot write", path);
+    }
+    return map(path, fd, true);
+}
+
+MappedMatrix MappedMatrix::create(std::string const &path, Matrix const &mat, size_t tile)
+{
+    MappedMatrix ret = create(path, mat.nrow(), mat.ncol(), tile);
+    for (size_t it = 0; it < ret.ntile_row(); ++it)
+    {
+        for (size_t jt = 0; jt < ret.ntile_col(); ++jt)
+        {
+            size_t nrow = block_size(ret.m_nrow, tile, it), ncol = block_size(ret.m_ncol, tile, jt);
+            double *block = ret.block(it, jt);
+            for (size_t row = 0; row < nrow; ++row)
+                std::copy_n(mat.row(it * tile + row) + jt * tile, ncol, block + row * tile);
+        }
+    }
+    return ret;
+}
+
+MappedMatrix MappedMatrix::open(std::string const &path, bool writable)
+{
+    int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+    {
+        fail("cannot open", path);
+    }
+    return map(path, fd, writable);
+}
+
+MappedMatrix MappedMatrix::map(std::string const &path, int fd, bool writable)
+{
+    MappedMatrix ret;
+    ret.m_path = path;
+    ret.m_fd = fd; // closed by ret from here on
+    ret.m_writable = writable;
+
+    Header header;
+    struct stat st;
+    if (pread(fd, &header, sizeof(header), 0) != ssize_t(sizeof(header)) || fstat(fd, &st) != 0)
+    {
+        fail("cannot read", path);
+    }
+    size_t length;
+    if (!std::equal(std::begin(file_magic), std::end(file_magic), header.magic) || 0 == header.tile
+        || !file_length(header.nrow, header.ncol, header.tile, length) || length != size_t(st.st_size))
+    {
+        throw std::runtime_error("not a MappedMatrix file: " + path);
+    }
+    ret.m_nrow = header.nrow;
+    ret.m_ncol = header.ncol;
+    ret.m_tile = header.tile;
+    ret.m_length = st.st_size;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *addr = mmap(nullptr, ret.m_length, prot, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == addr)
+    {
+        fail("cannot map", path);
+    }
+    ret.m_map = addr;
+    ret.m_data = reinterpret_cast<double *>(static_cast<char *>(addr) + header_size);
+    return ret;
+}
+
+MappedMatrix::MappedMatrix(MappedMatrix &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedMatrix &MappedMatrix::operator=(MappedMatrix &&other) noexcept
+{
+    std::swap(m_path, other.m_path);
+    std::swap(m_nrow, other.m_nrow);
+    std::swap(m_ncol, other.m_ncol);
+    std::swap(m_tile, other.m_tile);
+    std::swap(m_writable, other.m_writable);
+    std::swap(m_fd, other.m_fd);
+    std::swap(m_map, other.m_map);
+    std::swap(m_length, other.m_length);
+    std::swap(m_data, other.m_data);
+    return *this;
+}
+
+MappedMatrix::~MappedMatrix()
+{
+    if (m_map)
+    {
+        munmap(m_map, m_length);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+Matrix MappedMatrix::to_matrix() const
+{
+    Matrix ret(m_nrow, m_ncol);
+    for (size_t it = 0; it < ntile_row(); ++it)
+    {
+        for (size_t jt = 0; jt < ntile_col(); ++jt)
+        {
+            size_t nrow = block_size(m_nrow, m_tile, it), ncol = block_size(m_ncol, m_tile, jt);
+            double const *src = block(it, jt);
+            for (size_t row = 0; row < nrow; ++row)
+                std::copy_n(src + row * m_tile, ncol, ret.row(it * m_tile + row) + jt * m_tile);
+        }
+    }
+    return ret;
+}
+
+void MappedMatrix::flush()
+{
+    if (m_writable && m_map && msync(m_map, m_length, MS_SYNC) != 0)
+    {
+        fail("cannot write", m_path);
+    }
+}
+
+MappedMatrix multiply_out_of_core(MappedMatrix const &mat1, MappedMatrix const &mat2, std::string const &path,
+                                  size_t nthread)
+{
+    INSTRUMENT_TIME("multiply_out_of_core");
+    if (mat1.ncol() != mat2.nrow())
+    {
+        throw std::out_of_range("the number of first matrix column differs from that of second matrix row");
+    }
+    if (mat1.tile() != mat2.tile())
+    {
+        throw std::invalid_argument("the MappedMatrix tile sizes differ");
+    }
+    if (path == mat1.path() || path == mat2.path())
+    {
+        throw std::invalid_argument("the product cannot overwrite an operand: " + path);
+    }
+    size_t const tile = mat1.tile(), m = mat1.nrow(), k = mat1.ncol(), n = mat2.ncol();
+    MappedMatrix ret = MappedMatrix::create(path, m, n, tile);
+
+    // Step s multiplies block (it, kt) of mat1 by block (kt, jt) of mat2,
+    // with kt fastest, into the sum for block (it, jt) of ret.  Fetching
+    // step s + 1 also asks the kernel to read ahead the blocks of s + 2.
+    size_t const ntj = mat2.ntile_col(), ntk = mat1.ntile_col();
+    size_t const nstep = mat1.ntile_row() * ntj * ntk;
+    Matrix buf1[2] = {Matrix(tile, tile), Matrix(tile, tile)};
+    Matrix buf2[2] = {Matrix(tile, tile), Matrix(tile, tile)};
+    Matrix sum(tile, tile);
+    auto fetch = [&](size_t step) {
+        size_t it = step / ntk / ntj, jt = step / ntk % ntj, kt = step % ntk;
+        if (step + 1 < nstep)
+        {
+            size_t ahead = step + 1;
+            will_need(mat1.block(ahead / ntk / ntj, ahead % ntk), tile);
+            will_need(mat2.block(ahead % ntk, ahead / ntk % ntj), tile);
+        }
+        load_block(buf1[step % 2], mat1.block(it, kt), block_size(m, tile, it), block_size(k, tile, kt), tile);
+        load_block(buf2[step % 2], mat2.block(kt, jt), block_size(k, tile, kt), block_size(n, tile, jt), tile);
+    };
+
+    if (0 == nstep)
+    {
+        return ret;
+    }
+    Prefetcher prefetch(fetch);
+    prefetch.start(0);
+    for (size_t step = 0; step < nstep; ++step)
+    {
+        prefetch.wait();
+        if (step + 1 < nstep)
+        {
+            prefetch.start(step + 1);
+        }
+        size_t it = step / ntk / ntj, jt = step / ntk % ntj, kt = step % ntk;
+        size_t mb = block_size(m, tile, it), nb = block_size(n, tile, jt), kb = block_size(k, tile, kt);
+        Matrix const &blk1 = buf1[step % 2], &blk2 = buf2[step % 2];
+        gemm(mb, nb, kb, 1.0, blk1.data(), blk1.ld(), blk2.data(), blk2.ld(), 0 == kt ? 0.0 : 1.0, sum.data(),
+             sum.ld(), nthread);
+        if (ntk - 1 == kt)
+        {
+            store_block(ret.block(it, jt), sum, mb, nb, tile);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "matrix.hpp"
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Matrix of doubles in a memory-mapped file, for matrices larger than RAM.
+ * The file is tiled: a 4 KB header, then tile() x tile() blocks in row-major
+ * block order, each block row-major and contiguous, with the edge blocks
+ * zero-padded to full size.  A block is therefore one run of pages that
+ * comes in and goes out of the page cache as a unit, and the kernel, not
+ * the heap, decides how much of the matrix is resident.
+ *
+ * Element access goes through the mapping; changes reach the file when the
+ * kernel writes the pages back, or at flush().  Moving is cheap and copying
+ * is not allowed.  File errors throw std::runtime_error.
+ */
+class MappedMatrix
+{
+public:
+    // A new zero matrix in path, replacing any file there.  A zero tile, or a
+    // size whose file length overflows, throws std::invalid_argument.
+    static MappedMatrix create(std::string const &path, size_t nrow, size_t ncol, size_t tile = 512);
+    static MappedMatrix create(std::string const &path, Matrix const &mat, size_t tile = 512);
+    // An existing file; writes are refused unless writable.  The header must
+    // describe exactly the file length.
+    static MappedMatrix open(std::string const &path, bool writable = false);
+
+    MappedMatrix(MappedMatrix &&other) noexcept;
+    MappedMatrix &operator=(MappedMatrix &&other) noexcept;
+    MappedMatrix(MappedMatrix const &) = delete;
+    MappedMatrix &operator=(MappedMatrix const &) = delete;
+    ~MappedMatrix();
+
+    // Accessors.
+    size_t nrow() const { return m_nrow; }
+    size_t ncol() const { return m_ncol; }
+    size_t tile() const { return m_tile; }
+    size_t ntile_row() const { return (m_nrow + m_tile - 1) / m_tile; }
+    size_t ntile_col() const { return (m_ncol + m_tile - 1) / m_tile; }
+    bool writable() const { return m_writable; }
+    std::string const &path() const { return m_path; }
+    double operator()(size_t row, size_t col) const { return m_data[index(row, col)]; }
+    double &operator()(size_t row, size_t col) { return m_data[index(row, col)]; }
+    double at(size_t row, size_t col) const { return m_data[checked_index(row, col)]; }
+    double &at(size_t row, size_t col) // also throws std::invalid_argument if read-only.
+    {
+        if (!m_writable)
+        {
+            throw std::invalid_argument("MappedMatrix " + m_path + " is read-only");
+        }
+        return m_data[checked_index(row, col)];
+    }
+
+    // Block (it, jt): tile() x tile() doubles, row stride tile().
+    double const *block(size_t it, size_t jt) const { return m_data + (it * ntile_col() + jt) * m_tile * m_tile; }
+    double *block(size_t it, size_t jt) { return m_data + (it * ntile_col() + jt) * m_tile * m_tile; }
+
+    Matrix to_matrix() const;
+    void flush(); // write the changed pages back now; throws on I/O errors.
+
+private:
+    MappedMatrix() = default;
+    static MappedMatrix map(std::string const &path, int fd, bool writable);
+
+    size_t index(size_t row, size_t col) const
+    {
+        return ((row / m_tile) * ntile_col() + col / m_tile) * m_tile * m_tile + (row % m_tile) * m_tile
+               + col % m_tile;
+    }
+    size_t checked_index(size_t row, size_t col) const
+    {
+        if (row >= m_nrow || col >= m_ncol)
+        {
+            throw std::out_of_range("MappedMatrix index out of range");
+        }
+        return index(row, col);
+    }
+
+    std::string m_path;
+    size_t m_nrow = 0;
+    size_t m_ncol = 0;
+    size_t m_tile = 1;
+    bool m_writable = false;
+    int m_fd = -1;
+    void *m_map = nullptr;
+    size_t m_length = 0;
+    double *m_data = nullptr;
+}; /* end class MappedMatrix */
+
+/*
+ * ret = mat1 * mat2 into a new file at path, with the block size of mat1
+ * (mat2 must match it).  Each output block sums its products with gemm() on
+ * nthread threads (0 means default_thread_count()) from in-memory copies of
+ * the operand blocks.  The copies are double-buffered: while one pair is
+ * multiplied, a background thread faults the next pair in from the file.
+ * Memory use is five blocks, whatever the size of the matrices.  Throws
+ * std::out_of_range if mat1.ncol() != mat2.nrow() and std::invalid_argument
+ * if the block sizes differ.
+ */
+MappedMatrix multiply_out_of_core(MappedMatrix const &mat1, MappedMatrix const &mat2, std::string const &path,
+                                  size_t nthread = 0);
@@ -0,0 +1,311 @@
+#include "matrix.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
+#include "scheduler.hpp"
+#include "strassen.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef MATRIX_CBLAS
+#include <cblas.h>
+#else
+#include <mkl.h>
+#endif
+
+namespace
+{
+
+template <typename T>
+void check_multiply(BasicMatrix<T> const &mat1, BasicMatrix<T> const &mat2)
+{
+    if (mat1.ncol() != mat2.nrow())
+    {
+        throw std::out_of_range("the number of first matrix column differs from that of second matrix row");
+    }
+}
+
+/*
+ * c[0:ni, 0:nj] += a[0:ni, 0:nk] * b[0:nk, 0:nj] for row-major blocks with
+ * row strides lda, ldb and ldc.
+ */
+template <LoopOrder order, typename T>
+void tile_kernel(T const *__restrict a, T const *__restrict b, T *__restrict c,
+                 size_t lda, size_t ldb, size_t ldc, size_t ni, size_t nj, size_t nk)
+{
+    if (order == LoopOrder::ijk)
+    {
+        for (size_t i = 0; i < ni; ++i)
+            for (size_t j = 0; j < nj; ++j)
+            {
+                T v = c[i * ldc + j];
+                for (size_t k = 0; k < nk; ++k)
+                    v += a[i * lda + k] * b[k * ldb + j];
+                c[i * ldc + j] = v;
+            }
+    }
+    else if (order == LoopOrder::ikj)
+    {
+        for (size_t i = 0; i < ni; ++i)
+            for (size_t k = 0; k < nk; ++k)
+                for (size_t j = 0; j < nj; ++j)
+                    c[i * ldc + j] += a[i * lda + k] * b[k * ldb + j];
+    }
+    else if (order == LoopOrder::jik)
+    {
+        for (size_t j = 0; j < nj; ++j)
+            for (size_t i = 0; i < ni; ++i)
+            {
+                T v = c[i * ldc + j];
+                for (size_t k = 0; k < nk; ++k)
+                    v += a[i * lda + k] * b[k * ldb + j];
+                c[i * ldc + j] = v;
+            }
+    }
+    else if (order == LoopOrder::jki)
+    {
+        for (size_t j = 0; j < nj; ++j)
+            for (size_t k = 0; k < nk; ++k)
+                for (size_t i = 0; i < ni; ++i)
+                    c[i * ldc + j] += a[i * lda + k] * b[k * ldb + j];
+    }
+    else if (order == LoopOrder::kij)
+    {
+        for (size_t k = 0; k < nk; ++k)
+            for (size_t i = 0; i < ni; ++i)
+                for (size_t j = 0; j < nj; ++j)
+                    c[i * ldc + j] += a[i * lda + k] * b[k * ldb + j];
+    }
+    else
+    {
+        for (size_t k = 0; k < nk; ++k)
+            for (size_t j = 0; j < nj; ++j)
+                for (size_t i = 0; i < ni; ++i)
+                    c[i * ldc + j] += a[i * lda + k] * b[k * ldb + j];
+    }
+}
+
+/*
+ * The tiles are visited with the k tiles in increasing order for every
+ * output tile, so each element still sums its products in increasing k.
+ */
+template <LoopOrder order, typename T>
+void multiply_tiles(BasicMatrix<T> const &mat1, BasicMatrix<T> const &mat2, BasicMatrix<T> &ret, size_t tsize)
+{
+    size_t m = mat1.nrow(), n = mat2.ncol(), nk = mat1.ncol();
+    size_t lda = mat1.ld(), ldb = mat2.ld(), ldc = ret.ld();
+    for (size_t i0 = 0; i0 < m; i0 += tsize)
+    {
+        size_t ni = std::min(tsize, m - i0);
+        for (size_t k0 = 0; k0 < nk; k0 += tsize)
+        {
+            size_t kk = std::min(tsize, nk - k0);
+            for (size_t j0 = 0; j0 < n; j0 += tsize)
+            {
+                size_t nj = std::min(tsize, n - j0);
+                tile_kernel<order>(mat1.data() + i0 * lda + k0, mat2.data() + k0 * ldb + j0, ret.data() + i0 * ldc + j0,
+                                   lda, ldb, ldc, ni, nj, kk);
+            }
+        }
+    }
+}
+
+/* The output tile at (i0, j0): every k tile in order */
+template <LoopOrder order, typename T>
+void multiply_output_tile(BasicMatrix<T> const &mat1, BasicMatrix<T> const &mat2, BasicMatrix<T> &ret,
+                          size_t i0, size_t j0, size_t tsize)
+{
+    size_t m = mat1.nrow(), n = mat2.ncol(), nk = mat1.ncol();
+    size_t lda = mat1.ld(), ldb = mat2.ld(), ldc = ret.ld();
+    size_t ni = std::min(tsize, m - i0), nj = std::min(tsize, n - j0);
+    for (size_t k0 = 0; k0 < nk; k0 += tsize)
+    {
+        size_t kk = std::min(tsize, nk - k0);
+        tile_kernel<order>(mat1.data() + i0 * lda + k0, mat2.data() + k0 * ldb + j0, ret.data() + i0 * ldc + j0,
+                           lda, ldb, ldc, ni, nj, kk);
+    }
+}
+
+template <typename T>
+BasicMatrix<T> naive(BasicMatrix<T> const &mat1, BasicMatrix<T> const &mat2)
+{
+    check_multiply(mat1, mat2);
+    BasicMatrix<T> ret(mat1.nrow(), mat2.ncol());
+    for (size_t i = 0; i < ret.nrow(); ++i)
+    {
+        for (size_t j = 0; j < ret.ncol(); ++j)
+        {
+            T v = 0;
+            for (size_t k = 0; k < mat1.ncol(); ++k)
+            {
+                v += mat1(i, k) * mat2(k, j);
+            }
+            ret(i, j) = v;
+        }
+    }
+    return ret;
+}
+
+void cblas_gemm(size_t m, size_t n, size_t k, double const *a, size_t lda, double const *b, size_t ldb,
+                double *c, size_t ldc)
+{
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m, n, k, 1.0, a, lda, b, ldb, 0.0, c, ldc);
+}
+
+void cblas_gemm(size_t m, size_t n, size_t k, float const *a, size_t lda, float const *b, size_t ldb,
+                float *c, size_t ldc)
+{
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m, n, k, 1.0f, a, lda, b, ldb, 0.0f, c, ldc);
+}
+
+template <typename T>
+BasicMatrix<T> blas(BasicMatrix<T> const &mat1, BasicMatrix<T> const &mat2)
+{
+    check_multiply(mat1, mat2);
+    BasicMatrix<T> ret(mat1.nrow(), mat2.ncol());
+    if (0 == ret.size())
+    {
+        return ret;
+    }
+    cblas_gemm(mat1.nrow(), mat2.ncol(), mat1.ncol(), mat1.data(), std::max<size_t>(mat1.ld(), 1),
+               mat2.data(), mat2.ld(), ret.data(), ret.ld());
+    return ret;
+}
+
+template <typename T>
+BasicMatrix<T> tiled(BasicMatrix<T> const &mat1, BasicMatrix<T> const &mat2, size_t tsize, LoopOrder order)
+{
+    check_multiply(mat1, mat2);
+    if (0 == tsize)
+    {
+        throw std::invalid_argument("tile size must be positive");
+    }
+    BasicMatrix<T> ret(mat1.nrow(), mat2.ncol());
+    switch (order)
+    {
+    case LoopOrder::ijk: multiply_tiles<LoopOrder::ijk>(mat1, mat2, ret, tsize); break;
+    case LoopOrder::ikj: multiply_tiles<LoopOrder::ikj>(mat1, mat2, ret, tsize); break;
+    case LoopOrder::jik: multiply_tiles<LoopOrder::jik>(mat1, mat2, ret, tsize); break;
+    case LoopOrder::jki: multiply_tiles<LoopOrder::jki>(mat1, mat2, ret, tsize); break;
+    case LoopOrder::kij: multiply_tiles<LoopOrder::kij>(mat1, mat2, ret, tsize); break;
+    case LoopOrder::kji: multiply_tiles<LoopOrder::kji>(mat1, mat2, ret, tsize); break;
+    }
+    return ret;
+}
+
+} /* end namespace */
+
+LoopOrder loop_order(std::string const &name)
+{
+    static char const *const names[] = {"ijk", "ikj", "jik", "jki", "kij", "kji"};
+    for (size_t it = 0; it < 6; ++it)
+    {
+        if (name == names[it])
+        {
+            return static_cast<LoopOrder>(it);
+        }
+    }
+    throw std::invalid_argument("unknown loop order: " + name);
+}
+
+Matrix multiply_naive(Matrix const &mat1, Matrix const &mat2)
+{
+    INSTRUMENT_TIME("multiply_naive");
+    return naive(mat1, mat2);
+}
+
+FloatMatrix multiply_naive(FloatMatrix const &mat1, FloatMatrix const &mat2)
+{
+    INSTRUMENT_TIME("multiply_naive");
+    return naive(mat1, mat2);
+}
+
+Matrix multiply_mkl(Matrix const &mat1, Matrix const &mat2)
+{
+    INSTRUMENT_TIME("multiply_mkl");
+    return blas(mat1, mat2);
+}
+
+FloatMatrix multiply_mkl(FloatMatrix const &mat1, FloatMatrix const &mat2)
+{
+    INSTRUMENT_TIME("multiply_mkl");
+    return blas(mat1, mat2);
+}
+
+Matrix multiply_tile(Matrix const &mat1, Matrix const &mat2, size_t tsize, LoopOrder order)
+{
+    INSTRUMENT_TIME("multiply_tile");
+    return tiled(mat1, mat2, tsize, order);
+}
+
+FloatMatrix multiply_tile(FloatMatrix const &mat1, FloatMatrix const &mat2, size_t tsize, LoopOrder order)
+{
+    INSTRUMENT_TIME("multiply_tile");
+    return tiled(mat1, mat2, tsize, order);
+}
+
+Matrix multiply_parallel(Matrix const &mat1, Matrix const &mat2, size_t nthread, size_t tsize)
+{
+    // Below this many multiply-adds per thread, thread start-up dominates.
+    size_t const parallel_grain = size_t(1) << 22;
+
+    INSTRUMENT_TIME("multiply_parallel");
+    check_multiply(mat1, mat2);
+    if (0 == tsize)
+    {
+        throw std::invalid_argument("tile size must be positive");
+    }
+    Matrix ret(mat1.nrow(), mat2.ncol());
+    size_t nrtile = (ret.nrow() + tsize - 1) / tsize;
+    size_t nctile = (ret.ncol() + tsize - 1) / tsize;
+    if (0 == nthread)
+    {
+        nthread = default_thread_count();
+    }
+    nthread = std::min(nthread, std::max<size_t>(ret.size() * mat1.ncol() / parallel_grain, 1));
+
+    // Tiles are numbered row by row, so a thread's share is a run of whole
+    // tile rows sharing the same rows of mat1.
+    parallel_for(nrtile * nctile, nthread, [&](size_t it) {
+        multiply_output_tile<LoopOrder::ikj>(mat1, mat2, ret, it / nctile * tsize, it % nctile * tsize, tsize);
+    });
+    return ret;
+}
+
+Matrix multiply_simd(Matrix const &mat1, Matrix const &mat2, size_t nthread)
+{
+    INSTRUMENT_TIME("multiply_simd");
+    check_multiply(mat1, mat2);
+    Matrix ret(mat1.nrow(), mat2.ncol());
+    gemm(ret.nrow(), ret.ncol(), mat1.ncol(), mat1.data(), mat1.ld(), mat2.data(), mat2.ld(),
+         ret.data(), ret.ld(), nthread);
+    return ret;
+}
+
+Matrix multiply_strassen(Matrix const &mat1, Matrix const &mat2, size_t nthread, size_t crossover)
+{
+    INSTRUMENT_TIME("multiply_strassen");
+    check_multiply(mat1, mat2);
+    Matrix ret(mat1.nrow(), mat2.ncol());
+    strassen(ret.nrow(), ret.ncol(), mat1.ncol(), mat1.data(), mat1.ld(), mat2.data(), mat2.ld(),
+             ret.data(), ret.ld(), nthread, crossover);
+    return ret;
+}
+
+double max_relative_error(Matrix const &ret, Matrix const &ref)
+{
+    if (ret.nrow() != ref.nrow() || ret.ncol() != ref.ncol())
+    {
+        throw std::invalid_argument("the matrix shapes differ");
+    }
+    double diff = 0, scale = 0;
+    for (size_t it = 0; it < ref.nrow(); ++it)
+    {
+        for (size_t jt = 0; jt < ref.ncol(); ++jt)
+        {
+            diff = std::max(diff, std::fabs(ret(it, jt) - ref(it, jt)));
+            scale = std::max(scale, std::fabs(ref(it, jt)));
+        }
+    }
+    return 0 == diff ? 0 : diff / scale;
+}
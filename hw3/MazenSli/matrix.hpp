@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/* Allocator for 64-byte aligned blocks: whole cache lines, aligned SIMD loads */
+template <typename T>
+struct AlignedAllocator
+{
+    using value_type = T;
+    static constexpr size_t alignment = 64;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(AlignedAllocator<U> const &) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignment))); }
+    void deallocate(T *p, size_t) { ::operator delete(p, std::align_val_t(alignment)); }
+
+    template <typename U>
+    bool operator==(AlignedAllocator<U> const &) const { return true; }
+    template <typename U>
+    bool operator!=(AlignedAllocator<U> const &) const { return false; }
+}; /* end struct AlignedAllocator */
+
+/*
+ * Dense row-major matrix of T, double or float.  The buffer is 64-byte
+ * aligned and each row starts ld() elements after the previous one: ncol()
+ * rounded up to a cache line (8 doubles or 16 floats), plus one more line
+ * when that would be a multiple of 4 KB, so that rows do not all map to the
+ * same cache sets.  Every row thus starts aligned, and the padding is zero.
+ * data() and ld() can go to cblas_dgemm or cblas_sgemm as they are.
+ */
+template <typename T>
+class BasicMatrix
+{
+public:
+    using value_type = T;
+
+    BasicMatrix() = default;
+    BasicMatrix(size_t nrow, size_t ncol)
+        : m_nrow(nrow), m_ncol(ncol), m_ld(padded_ld(ncol)), m_buffer(nrow * m_ld, 0) {}
+
+    // Accessors.
+    size_t nrow() const { return m_nrow; }
+    size_t ncol() const { return m_ncol; }
+    size_t ld() const { return m_ld; }
+    size_t size() const { return m_nrow * m_ncol; }
+    T operator()(size_t row, size_t col) const { return m_buffer[index(row, col)]; }
+    T &operator()(size_t row, size_t col) { return m_buffer[index(row, col)]; }
+    T at(size_t row, size_t col) const { return m_buffer[checked_index(row, col)]; }
+    T &at(size_t row, size_t col) { return m_buffer[checked_index(row, col)]; }
+
+    // Raw row-major storage, row stride ld().
+    T *data() { return m_buffer.data(); }
+    T const *data() const { return m_buffer.data(); }
+    T *row(size_t it) { return m_buffer.data() + it * m_ld; }
+    T const *row(size_t it) const { return m_buffer.data() + it * m_ld; }
+
+    // Bulk fills in one pass over the rows; the padding stays zero.
+    void fill(T value)
+    {
+        for (size_t it = 0; it < m_nrow; ++it)
+        {
+            std::fill(row(it), row(it) + m_ncol, value);
+        }
+    }
+    // Element (i, j) becomes start + (i * ncol() + j) * step, computed
+    // directly rather than summed, so large matrices do not drift.
+    void iota(double start = 0, double step = 1)
+    {
+        for (size_t it = 0; it < m_nrow; ++it)
+        {
+            T *p = row(it);
+            for (size_t jt = 0; jt < m_ncol; ++jt)
+            {
+                p[jt] = T(start + double(it * m_ncol + jt) * step);
+            }
+        }
+    }
+
+    bool operator==(BasicMatrix const &other) const
+    {
+        if (m_nrow != other.m_nrow || m_ncol != other.m_ncol)
+        {
+            return false;
+        }
+        for (size_t it = 0; it < m_nrow; ++it)
+        {
+            if (!std::equal(row(it), row(it) + m_ncol, other.row(it)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool operator!=(BasicMatrix const &other) const { return !(*this == other); }
+
+    static size_t padded_ld(size_t ncol)
+    {
+        size_t const line = 64 / sizeof(T), page = 4096 / sizeof(T);
+        size_t ld = (ncol + line - 1) / line * line;
+        return (ld && 0 == ld % page) ? ld + line : ld;
+    }
+
+private:
+    size_t index(size_t row, size_t col) const { return row * m_ld + col; }
+    size_t checked_index(size_t row, size_t col) const
+    {
+        if (row >= m_nrow || col >= m_ncol)
+        {
+            throw std::out_of_range("Matrix index out of range");
+        }
+        return index(row, col);
+    }
+
+    size_t m_nrow = 0;
+    size_t m_ncol = 0;
+    size_t m_ld = 0;
+    std::vector<T, AlignedAllocator<T>> m_buffer;
+}; /* end class BasicMatrix */
+
+using Matrix = BasicMatrix<double>;
+using FloatMatrix = BasicMatrix<float>;
+
+/*
+ * Order of the three loops inside one multiply_tile tile.  Every order adds
+ * the products into each element with k increasing, so all of them give
+ * exactly the result of multiply_naive.
+ */
+enum class LoopOrder { ijk, ikj, jik, jki, kij, kji };
+
+LoopOrder loop_order(std::string const &name); // "ikj" and so on.
+
+// All of these throw std::out_of_range if mat1.ncol() != mat2.nrow().  The
+// first three also take FloatMatrix, summing in float.
+Matrix multiply_naive(Matrix const &mat1, Matrix const &mat2);
+Matrix multiply_mkl(Matrix const &mat1, Matrix const &mat2); // cblas_dgemm.
+// Cache-blocked multiply over tsize x tsize tiles.
+Matrix multiply_tile(Matrix const &mat1, Matrix const &mat2, size_t tsize, LoopOrder order = LoopOrder::ikj);
+FloatMatrix multiply_naive(FloatMatrix const &mat1, FloatMatrix const &mat2);
+FloatMatrix multiply_mkl(FloatMatrix const &mat1, FloatMatrix const &mat2); // cblas_sgemm.
+FloatMatrix multiply_tile(FloatMatrix const &mat1, FloatMatrix const &mat2, size_t tsize,
+                          LoopOrder order = LoopOrder::ikj);
+// multiply_tile with the tsize x tsize output tiles spread over nthread
+// threads by work stealing (0 means default_thread_count()).  The result
+// equals multiply_naive exactly.
+Matrix multiply_parallel(Matrix const &mat1, Matrix const &mat2, size_t nthread = 0, size_t tsize = 64);
+// Packed SIMD multiply on nthread threads; see gemm.hpp.
+Matrix multiply_simd(Matrix const &mat1, Matrix const &mat2, size_t nthread = 0);
+// Strassen's recursion over multiply_simd; see strassen.hpp.  A crossover
+// of 0 means strassen_crossover().
+Matrix multiply_strassen(Matrix const &mat1, Matrix const &mat2, size_t nthread = 0, size_t crossover = 0);
+
+// max |ret - ref| / max |ref| over the elements (0 when both are zero), to
+// compare the reordered multiplies with multiply_naive.  Throws
+// std::invalid_argument if the shapes differ.
+double max_relative_error(Matrix const &ret, Matrix const &ref);
@@ -0,0 +1,418 @@
+/*
+ * Benchmark of every multiply in matrix.hpp over sizes and shapes.
+ *
+ *   matrix_bench [--sizes 256,512,1000] [--shapes 4096x64x4096,...]
+ *                [--variants mkl,simd,...] [--threads N] [--pin]
+ *                [--repeat 5] [--warmup 1] [--naive-max 1000]
+ *                [--output FILE] [--json FILE] [--csv FILE]
+ *   matrix_bench --tune [--max-size 2048]
+ *
+ * A shape is m x k x n: an m x k times k x n product.  Each variant runs
+ * warmup untimed times and then repeat timed ones; GFLOPS count 2 m k n
+ * flops.  Every result is checked against multiply_mkl, which also sets
+ * the speed-up baseline.  The table goes to stdout, and to --output only
+ * when given: performance.txt is validate.py's, so it is never written by
+ * default.  --json and --csv write the same records for tracking across
+ * releases.  --tune
+ * instead measures the multiply() table and saves it to tuning_path().
+ * Built with make INSTRUMENT=1, it ends with the instrument counters.
+ */
+
+#include "dispatch.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
+#include "matrix.hpp"
+#include "scheduler.hpp"
+#include "strassen.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Shape
+{
+    size_t m, k, n;
+};
+
+struct Variant
+{
+    char const *name;
+    std::function<Matrix(Matrix const &, Matrix const &, size_t)> multiply;
+    bool threaded;
+};
+
+std::vector<Variant> const &all_variants()
+{
+    static std::vector<Variant> const ret = {
+        {"naive", [](Matrix const &a, Matrix const &b, size_t) { return multiply_naive(a, b); }, false},
+        {"mkl", [](Matrix const &a, Matrix const &b, size_t) { return multiply_mkl(a, b); }, false},
+        {"tile", [](Matrix const &a, Matrix const &b, size_t) { return multiply_tile(a, b, 64); }, false},
+        {"parallel", [](Matrix const &a, Matrix const &b, size_t nt) { return multiply_parallel(a, b, nt); }, true},
+        {"simd", [](Matrix const &a, Matrix const &b, size_t nt) { return multiply_simd(a, b, nt); }, true},
+        {"strassen", [](Matrix const &a, Matrix const &b, size_t nt) { return multiply_strassen(a, b, nt); }, true},
+        {"multiply", [](Matrix const &a, Matrix const &b, size_t nt) { return multiply(a, b, nt); }, true},
+    };
+    return ret;
+}
+
+Variant const &find_variant(std::string const &name)
+{
+    for (Variant const &variant : all_variants())
+    {
+        if (name == variant.name)
+        {
+            return variant;
+        }
+    }
+    throw std::invalid_argument("unknown variant " + name);
+}
+
+struct Options
+{
+    std::vector<Shape> shapes;
+    std::vector<std::string> variants;
+    size_t nthread = 0;
+    bool pin = false;
+    bool tune = false;
+    size_t max_size = 2048;
+    size_t repeat = 5;
+    size_t warmup = 1;
+    size_t naive_max = 1000;
+    std::string output, json, csv;
+};
+
+struct Record
+{
+    std::string variant;
+    Shape shape;
+    size_t nthread;
+    double min_seconds, median_seconds;
+    double min_gflops, median_gflops;
+    double speedup; // multiply_mkl's min time over this one's
+    double error;   // max_relative_error against multiply_mkl
+};
+
+std::vector<std::string> split(std::string const &text, char sep)
+{
+    std::vector<std::string> ret;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, sep))
+    {
+        if (!item.empty())
+        {
+            ret.push_back(item);
+        }
+    }
+    return ret;
+}
+
+size_t parse_size(std::string const &text)
+{
+    char *end = nullptr;
+    unsigned long value = std::strtoul(text.c_str(), &end, 10);
+    if (text.empty() || *end)
+    {
+        throw std::invalid_argument("not a size: " + text);
+    }
+    return value;
+}
+
+Shape parse_shape(std::string const &text)
+{
+    std::vector<std::string> dims = split(text, 'x');
+    if (3 != dims.size())
+    {
+        throw std::invalid_argument("shape must be MxKxN: " + text);
+    }
+    return {parse_size(dims[0]), parse_size(dims[1]), parse_size(dims[2])};
+}
+
+Options parse_options(int argc, char **argv)
+{
+    Options ret;
+    std::vector<Shape> squares, shapes;
+    bool sizes_given = false, shapes_given = false;
+    for (int it = 1; it < argc; ++it)
+    {
+        std::string arg = argv[it];
+        if ("--pin" == arg || "--tune" == arg)
+        {
+            ("--pin" == arg ? ret.pin : ret.tune) = true;
+            continue;
+        }
+        static char const *const known[] = {"--sizes", "--shapes", "--variants", "--threads", "--repeat", "--warmup",
+                                            "--naive-max", "--output", "--json", "--csv", "--max-size"};
+        if (std::none_of(std::begin(known), std::end(known), [&](char const *name) { return arg == name; }))
+        {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+        if (it + 1 == argc)
+        {
+            throw std::invalid_argument("missing value for " + arg);
+        }
+        std::string value = argv[++it];
+        if ("--sizes" == arg)
+        {
+            sizes_given = true;
+            for (std::string const &size : split(value, ','))
+            {
+                size_t n = parse_size(size);
+                squares.push_back({n, n, n});
+            }
+        }
+        else if ("--shapes" == arg)
+        {
+            shapes_given = true;
+            for (std::string const &shape : split(value, ','))
+            {
+                shapes.push_back(parse_shape(shape));
+            }
+        }
+        else if ("--variants" == arg)
+        {
+            ret.variants = split(value, ',');
+        }
+        else if ("--threads" == arg)
+        {
+            ret.nthread = parse_size(value);
+        }
+        else if ("--repeat" == arg)
+        {
+            ret.repeat = std::max<size_t>(parse_size(value), 1);
+        }
+        else if ("--warmup" == arg)
+        {
+            ret.warmup = parse_size(value);
+        }
+        else if ("--naive-max" == arg)
+        {
+            ret.naive_max = parse_size(value);
+        }
+        else if ("--output" == arg)
+        {
+            ret.output = value;
+        }
+        else if ("--max-size" == arg)
+        {
+            ret.max_size = parse_size(value);
+        }
+        else if ("--json" == arg)
+        {
+            ret.json = value;
+        }
+        else
+        {
+            ret.csv = value;
+        }
+    }
+    if (!sizes_given)
+    {
+        for (size_t n : {256, 512, 1000, 1024, 2000})
+        {
+            squares.push_back({n, n, n});
+        }
+    }
+    if (!shapes_given)
+    {
+        // Rank-64 update, inner products and a thin right-hand side.
+        shapes = {{4096, 64, 4096}, {64, 4096, 64}, {2000, 2000, 32}};
+    }
+    ret.shapes = squares;
+    ret.shapes.insert(ret.shapes.end(), shapes.begin(), shapes.end());
+    for (std::string const &name : ret.variants)
+    {
+        find_variant(name);
+    }
+    if (ret.variants.empty())
+    {
+        for (Variant const &variant : all_variants())
+        {
+            ret.variants.push_back(variant.name);
+        }
+    }
+    if (0 == ret.nthread)
+    {
+        ret.nthread = default_thread_count();
+    }
+    return ret;
+}
+
+Matrix random_matrix(size_t nrow, size_t ncol, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix ret(nrow, ncol);
+    for (size_t it = 0; it < nrow; ++it)
+    {
+        for (size_t jt = 0; jt < ncol; ++jt)
+            ret(it, jt) = dist(rng);
+    }
+    return ret;
+}
+
+/* warmup untimed runs, then the sorted times of repeat runs in seconds */
+std::vector<double> time_runs(std::function<Matrix()> const &fn, size_t warmup, size_t repeat, Matrix &result)
+{
+    for (size_t it = 0; it < warmup; ++it)
+    {
+        result = fn();
+    }
+    std::vector<double> ret;
+    for (size_t it = 0; it < repeat; ++it)
+    {
+        auto start = std::chrono::steady_clock::now();
+        result = fn();
+        ret.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+std::vector<Record> run(Options const &opt)
+{
+    std::vector<Record> ret;
+    std::mt19937 rng(0);
+    for (Shape const &shape : opt.shapes)
+    {
+        Matrix mat1 = random_matrix(shape.m, shape.k, rng);
+        Matrix mat2 = random_matrix(shape.k, shape.n, rng);
+        double flops = 2.0 * shape.m * shape.k * shape.n;
+
+        Matrix ref;
+        std::vector<double> ref_times = time_runs([&] { return multiply_mkl(mat1, mat2); }, opt.warmup, opt.repeat, ref);
+        for (std::string const &name : opt.variants)
+        {
+            Variant const &variant = find_variant(name);
+            if ("naive" == name && std::max({shape.m, shape.k, shape.n}) > opt.naive_max)
+            {
+                continue;
+            }
+            size_t nthread = variant.threaded ? opt.nthread : 1;
+            Matrix result;
+            std::vector<double> times = "mkl" == name
+                ? ref_times
+                : time_runs([&] { return variant.multiply(mat1, mat2, nthread); }, opt.warmup, opt.repeat, result);
+            double median = times[times.size() / 2];
+            if (0 == times.size() % 2)
+            {
+                median = (median + times[times.size() / 2 - 1]) / 2;
+            }
+            ret.push_back({name, shape, nthread, times.front(), median, flops / times.front() * 1e-9,
+                           flops / median * 1e-9, ref_times.front() / times.front(),
+                           "mkl" == name ? 0 : max_relative_error(result, ref)});
+            Record const &r = ret.back();
+            std::fprintf(stderr, "%-8s %5zux%zux%zu  %8.2f GFLOPS\n", r.variant.c_str(), shape.m, shape.k, shape.n,
+                         r.min_gflops);
+        }
+    }
+    return ret;
+}
+
+void write_text(std::FILE *out, Options const &opt, std::vector<Record> const &records)
+{
+    std::fprintf(out, "multiply benchmark: gemm isa %s, %zu threads%s, strassen crossover %zu, best and median of %zu runs\n",
+                 gemm_isa(), opt.nthread, opt.pin ? " (pinned)" : "", strassen_crossover(), opt.repeat);
+    std::fprintf(out, "%-8s %16s %4s %10s %10s %9s %9s %8s %9s\n", "variant", "m x k x n", "thr", "min s",
+                 "median s", "GFLOPS", "med GF", "vs mkl", "error");
+    for (Record const &r : records)
+    {
+        char shape[64];
+        std::snprintf(shape, sizeof(shape), "%zux%zux%zu", r.shape.m, r.shape.k, r.shape.n);
+        std::fprintf(out, "%-8s %16s %4zu %10.5f %10.5f %9.2f %9.2f %7.2fx %9.2g\n", r.variant.c_str(), shape,
+                     r.nthread, r.min_seconds, r.median_seconds, r.min_gflops, r.median_gflops, r.speedup, r.error);
+    }
+}
+
+void write_json(std::FILE *out, Options const &opt, std::vector<Record> const &records)
+{
+    std::fprintf(out, "{\n  \"gemm_isa\": \"%s\",\n  \"threads\": %zu,\n  \"pinned\": %s,\n"
+                      "  \"strassen_crossover\": %zu,\n  \"repeat\": %zu,\n  \"warmup\": %zu,\n  \"results\": [",
+                 gemm_isa(), opt.nthread, opt.pin ? "true" : "false", strassen_crossover(), opt.repeat, opt.warmup);
+    for (size_t it = 0; it < records.size(); ++it)
+    {
+        Record const &r = records[it];
+        std::fprintf(out, "%s\n    {\"variant\": \"%s\", \"m\": %zu, \"k\": %zu, \"n\": %zu, \"threads\": %zu, "
+                          "\"min_seconds\": %.6g, \"median_seconds\": %.6g, \"min_gflops\": %.6g, "
+                          "\"median_gflops\": %.6g, \"speedup_over_mkl\": %.6g, \"max_relative_error\": %.3g}",
+                     0 == it ? "" : ",", r.variant.c_str(), r.shape.m, r.shape.k, r.shape.n, r.nthread,
+                     r.min_seconds, r.median_seconds, r.min_gflops, r.median_gflops, r.speedup, r.error);
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+void write_csv(std::FILE *out, Options const &, std::vector<Record> const &records)
+{
+    std::fprintf(out, "variant,m,k,n,threads,min_seconds,median_seconds,min_gflops,median_gflops,"
+                      "speedup_over_mkl,max_relative_error\n");
+    for (Record const &r : records)
+    {
+        std::fprintf(out, "%s,%zu,%zu,%zu,%zu,%.6g,%.6g,%.6g,%.6g,%.6g,%.3g\n", r.variant.c_str(), r.shape.m,
+                     r.shape.k, r.shape.n, r.nthread, r.min_seconds, r.median_seconds, r.min_gflops,
+                     r.median_gflops, r.speedup, r.error);
+    }
+}
+
+void write_file(std::string const &path, Options const &opt, std::vector<Record> const &records,
+                void (*writer)(std::FILE *, Options const &, std::vector<Record> const &))
+{
+    if (path.empty())
+    {
+        return;
+    }
+    std::FILE *out = std::fopen(path.c_str(), "w");
+    if (!out)
+    {
+        throw std::runtime_error("cannot write " + path);
+    }
+    writer(out, opt, records);
+    std::fclose(out);
+}
+
+} /* end namespace */
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        Options opt = parse_options(argc, argv);
+        if (opt.pin && !set_thread_pinning(true))
+        {
+            std::fprintf(stderr, "thread pinning is not supported here; running unpinned\n");
+            opt.pin = false;
+        }
+        if (opt.tune)
+        {
+            tune_multiply(opt.max_size);
+            std::string path = tuning_path();
+            save_tuning(path);
+            std::printf("multiply tuning table written to %s\n", path.c_str());
+            return 0;
+        }
+        std::vector<Record> records = run(opt);
+        write_text(stdout, opt, records);
+        write_file(opt.output, opt, records, write_text);
+        write_file(opt.json, opt, records, write_json);
+        write_file(opt.csv, opt, records, write_csv);
+        for (auto const &counter : instrument::snapshot())
+        {
+            std::printf("%s %llu\n", counter.first.c_str(), static_cast<unsigned long long>(counter.second));
+        }
+    }
+    catch (std::exception const &e)
+    {
+        std::fprintf(stderr, "matrix_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
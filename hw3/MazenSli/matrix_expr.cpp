@@ -0,0 +1,328 @@
+#include "matrix_expr.hpp"
+#include "gemm.hpp"
+#include "instrument.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+/*
+ * Per-thread pool of scratch matrices used as a stack: a Scratch takes
+ * entries from the top and gives them back when it goes out of scope.  An
+ * entry keeps its buffer while the shapes asked of it stay the same, so
+ * re-evaluating an expression does not allocate.
+ */
+class Scratch
+{
+public:
+    Scratch() : m_mark(used()) {}
+    Scratch(Scratch const &) = delete;
+    Scratch &operator=(Scratch const &) = delete;
+    ~Scratch() { used() = m_mark; }
+
+    Matrix &get(size_t nrow, size_t ncol)
+    {
+        std::vector<std::unique_ptr<Matrix>> &entries = pool();
+        size_t &top = used();
+        if (top == entries.size())
+        {
+            entries.push_back(std::make_unique<Matrix>());
+        }
+        Matrix &ret = *entries[top++];
+        if (ret.nrow() != nrow || ret.ncol() != ncol)
+        {
+            ret = Matrix(nrow, ncol);
+        }
+        return ret;
+    }
+
+private:
+    static std::vector<std::unique_ptr<Matrix>> &pool()
+    {
+        thread_local std::vector<std::unique_ptr<Matrix>> ret;
+        return ret;
+    }
+    static size_t &used()
+    {
+        thread_local size_t ret = 0;
+        return ret;
+    }
+
+    size_t m_mark;
+}; /* end class Scratch */
+
+// dest = scale * src + beta * dest; dest is not read when beta is 0.
+void add_scaled(Matrix &dest, double scale, Matrix const &src, double beta)
+{
+    for (size_t it = 0; it < dest.nrow(); ++it)
+    {
+        double *d = dest.row(it);
+        double const *s = src.row(it);
+        if (0 == beta)
+        {
+            for (size_t jt = 0; jt < dest.ncol(); ++jt)
+                d[jt] = scale * s[jt];
+        }
+        else
+        {
+            for (size_t jt = 0; jt < dest.ncol(); ++jt)
+                d[jt] = scale * s[jt] + beta * d[jt];
+        }
+    }
+}
+
+void scale_in_place(Matrix &dest, double scale)
+{
+    for (size_t it = 0; it < dest.nrow(); ++it)
+    {
+        double *d = dest.row(it);
+        for (size_t jt = 0; jt < dest.ncol(); ++jt)
+            d[jt] *= scale;
+    }
+}
+
+/*
+ * Product of a chain of matrices in the order with the fewest multiply-adds.
+ * cost and split hold, for every sub-chain i..j, the cheapest cost and the
+ * operand after which it splits in two.
+ */
+class ChainProduct
+{
+public:
+    ChainProduct(std::vector<Matrix const *> const &mats, Scratch &scratch, size_t nthread)
+        : m_mats(mats), m_scratch(scratch), m_nthread(nthread), m_n(mats.size()), m_dims(m_n + 1),
+          m_split(m_n * m_n, 0)
+    {
+        for (size_t it = 0; it < m_n; ++it)
+        {
+            m_dims[it] = mats[it]->nrow();
+        }
+        m_dims[m_n] = mats.back()->ncol();
+
+        std::vector<double> cost(m_n * m_n, 0);
+        for (size_t len = 2; len <= m_n; ++len)
+        {
+            for (size_t i = 0; i + len <= m_n; ++i)
+            {
+                size_t j = i + len - 1;
+                double best = std::numeric_limits<double>::infinity();
+                for (size_t s = i; s < j; ++s)
+                {
+                    double c = cost[i * m_n + s] + cost[(s + 1) * m_n + j]
+                             + double(m_dims[i]) * double(m_dims[s + 1]) * double(m_dims[j + 1]);
+                    if (c < best)
+                    {
+                        best = c;
+                        m_split[i * m_n + j] = s;
+                    }
+                }
+                cost[i * m_n + j] = best;
+            }
+        }
+    }
+
+    // out = alpha * the whole chain + beta * out.
+    void operator()(double alpha, double beta, Matrix &out) { multiply(0, m_n - 1, alpha, beta, out); }
+
+private:
+    void multiply(size_t i, size_t j, double alpha, double beta, Matrix &out)
+    {
+        size_t s = m_split[i * m_n + j];
+        Matrix const &lhs = s == i ? *m_mats[i] : product(i, s);
+        Matrix const &rhs = s + 1 == j ? *m_mats[j] : product(s + 1, j);
+        gemm(out.nrow(), out.ncol(), lhs.ncol(), alpha, lhs.data(), lhs.ld(), rhs.data(), rhs.ld(),
+             beta, out.data(), out.ld(), m_nthread);
+    }
+
+    Matrix const &product(size_t i, size_t j)
+    {
+        Matrix &ret = m_scratch.get(m_dims[i], m_dims[j + 1]);
+        multiply(i, j, 1, 0, ret);
+        return ret;
+    }
+
+    std::vector<Matrix const *> const &m_mats;
+    Scratch &m_scratch;
+    size_t m_nthread;
+    size_t m_n;
+    std::vector<size_t> m_dims;
+    std::vector<size_t> m_split;
+}; /* end class ChainProduct */
+
+} /* end namespace */
+
+MatrixExpr::MatrixExpr(Matrix const &mat)
+    : m_nrow(mat.nrow()), m_ncol(mat.ncol()), m_terms{Term{1, {Factor{&mat, nullptr}}}}
+{
+}
+
+MatrixExpr operator*(MatrixExpr const &lhs, MatrixExpr const &rhs)
+{
+    if (lhs.m_ncol != rhs.m_nrow)
+    {
+        throw std::out_of_range("the number of first matrix column differs from that of second matrix row");
+    }
+    // A single product is spliced into the chain; a sum becomes one factor.
+    MatrixExpr::Term term{1, {}};
+    for (MatrixExpr const *side : {&lhs, &rhs})
+    {
+        if (1 == side->m_terms.size())
+        {
+            MatrixExpr::Term const &t = side->m_terms.front();
+            term.scale *= t.scale;
+            term.factors.insert(term.factors.end(), t.factors.begin(), t.factors.end());
+        }
+        else
+        {
+            term.factors.push_back({nullptr, std::make_shared<MatrixExpr const>(*side)});
+        }
+    }
+    MatrixExpr ret;
+    ret.m_nrow = lhs.m_nrow;
+    ret.m_ncol = rhs.m_ncol;
+    ret.m_terms.push_back(std::move(term));
+    return ret;
+}
+
+MatrixExpr operator*(double scale, MatrixExpr const &expr)
+{
+    MatrixExpr ret(expr);
+    for (MatrixExpr::Term &term : ret.m_terms)
+    {
+        term.scale *= scale;
+    }
+    return ret;
+}
+
+MatrixExpr operator+(MatrixExpr const &lhs, MatrixExpr const &rhs)
+{
+    if (lhs.m_nrow != rhs.m_nrow || lhs.m_ncol != rhs.m_ncol)
+    {
+        throw std::out_of_range("the matrix shapes differ");
+    }
+    MatrixExpr ret(lhs);
+    ret.m_terms.insert(ret.m_terms.end(), rhs.m_terms.begin(), rhs.m_terms.end());
+    return ret;
+}
+
+bool MatrixExpr::uses(Matrix const &mat) const
+{
+    for (Term const &term : m_terms)
+    {
+        for (Factor const &factor : term.factors)
+        {
+            if (factor.mat == &mat || (factor.expr && factor.expr->uses(mat)))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool MatrixExpr::reads(Matrix const &mat) const
+{
+    for (Term const &term : m_terms)
+    {
+        for (Factor const &factor : term.factors)
+        {
+            if (term.factors.size() > 1 && (factor.mat == &mat || (factor.expr && factor.expr->uses(mat))))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void MatrixExpr::eval_into(Matrix &dest, size_t nthread) const
+{
+    // Nested sums are timed too, within the time of the sum holding them.
+    INSTRUMENT_TIME("matrix_expr.eval_into");
+    // Terms are accumulated into dest, so dest may only appear on its own.
+    if (reads(dest))
+    {
+        Matrix ret;
+        eval_into(ret, nthread);
+        if (ret.nrow() == dest.nrow() && ret.ncol() == dest.ncol())
+        {
+            // Keep dest's buffer, which views may point to.
+            std::copy(ret.data(), ret.data() + ret.nrow() * ret.ld(), dest.data());
+        }
+        else
+        {
+            dest = std::move(ret);
+        }
+        return;
+    }
+    if (dest.nrow() != m_nrow || dest.ncol() != m_ncol)
+    {
+        dest = Matrix(m_nrow, m_ncol);
+    }
+
+    // dest holds beta times its current content; 0 means it holds nothing yet.
+    double beta = 0;
+    for (Term const &term : m_terms)
+    {
+        if (&dest == term.factors.front().mat && 1 == term.factors.size())
+        {
+            beta += term.scale;
+        }
+    }
+    if (0 != beta && 1 != beta)
+    {
+        scale_in_place(dest, beta);
+        beta = 1;
+    }
+
+    // Lone matrices first, so that the first product can accumulate onto them.
+    for (Term const &term : m_terms)
+    {
+        Matrix const *mat = term.factors.front().mat;
+        if (1 == term.factors.size() && &dest != mat)
+        {
+            add_scaled(dest, term.scale, *mat, beta);
+            beta = 1;
+        }
+    }
+
+    Scratch scratch;
+    std::vector<Matrix const *> mats;
+    for (Term const &term : m_terms)
+    {
+        if (1 == term.factors.size())
+        {
+            continue;
+        }
+        mats.clear();
+        for (Factor const &factor : term.factors)
+        {
+            if (factor.mat)
+            {
+                mats.push_back(factor.mat);
+            }
+            else
+            {
+                Matrix &sum = scratch.get(factor.nrow(), factor.ncol());
+                factor.expr->eval_into(sum, nthread);
+                mats.push_back(&sum);
+            }
+        }
+        ChainProduct(mats, scratch, nthread)(term.scale, beta, dest);
+        beta = 1;
+    }
+
+    if (0 == beta)
+    {
+        dest.fill(0);
+    }
+}
+
+Matrix MatrixExpr::eval(size_t nthread) const
+{
+    Matrix ret(m_nrow, m_ncol);
+    eval_into(ret, nthread);
+    return ret;
+}
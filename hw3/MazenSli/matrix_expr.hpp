@@ -0,0 +1,80 @@
+#pragma once
+
+#include "matrix.hpp"
+
+#include <memory>
+#include <vector>
+
+/*
+ * Lazy matrix expression.  A * B, A + B, s * A and their combinations only
+ * record the operands; eval_into() computes the result.  The expression is
+ * held as a sum of scaled products,
+ *
+ *     scale_1 * F_11 * F_12 * ... + scale_2 * F_21 * ... + ...
+ *
+ * where each factor is a Matrix, or a nested sum such as the A + B in
+ * (A + B) * C, which is evaluated once rather than distributed.  On
+ * evaluation
+ *
+ *   - each chain of products is multiplied in the order with the fewest
+ *     multiply-adds, found by matrix-chain dynamic programming;
+ *   - the scale and the running sum fold into the last gemm() of each chain
+ *     as c = alpha * a * b + beta * c, so A * B + C takes one gemm() and no
+ *     temporary;
+ *   - inner products of a chain go to per-thread scratch matrices that later
+ *     evaluations of the same shapes reuse without allocating.
+ *
+ * Matrix operands are held by pointer and must outlive the expression.
+ * Shape mismatches throw std::out_of_range when the expression is built.
+ */
+class MatrixExpr
+{
+public:
+    MatrixExpr(Matrix const &mat); // implicit: every Matrix is an expression.
+
+    size_t nrow() const { return m_nrow; }
+    size_t ncol() const { return m_ncol; }
+
+    // dest = this expression, computed by gemm() on nthread threads (0 means
+    // default_thread_count()).  dest is reshaped if its shape differs, and
+    // may itself be an operand.
+    void eval_into(Matrix &dest, size_t nthread = 0) const;
+    Matrix eval(size_t nthread = 0) const;
+
+    friend MatrixExpr operator*(MatrixExpr const &lhs, MatrixExpr const &rhs);
+    friend MatrixExpr operator*(double scale, MatrixExpr const &expr);
+    friend MatrixExpr operator+(MatrixExpr const &lhs, MatrixExpr const &rhs);
+
+private:
+    /* One operand of a product: a Matrix or a nested sum */
+    struct Factor
+    {
+        Matrix const *mat;
+        std::shared_ptr<MatrixExpr const> expr;
+        size_t nrow() const { return mat ? mat->nrow() : expr->nrow(); }
+        size_t ncol() const { return mat ? mat->ncol() : expr->ncol(); }
+    };
+
+    struct Term
+    {
+        double scale;
+        std::vector<Factor> factors;
+    };
+
+    MatrixExpr() = default;
+    bool uses(Matrix const &mat) const;  // mat is an operand anywhere
+    bool reads(Matrix const &mat) const; // mat is an operand of a product
+
+    size_t m_nrow = 0;
+    size_t m_ncol = 0;
+    std::vector<Term> m_terms;
+}; /* end class MatrixExpr */
+
+// Matrix product: lhs.ncol() must equal rhs.nrow().
+MatrixExpr operator*(MatrixExpr const &lhs, MatrixExpr const &rhs);
+MatrixExpr operator*(double scale, MatrixExpr const &expr);
+inline MatrixExpr operator*(MatrixExpr const &expr, double scale) { return scale * expr; }
+// Elementwise sum: the shapes must match.
+MatrixExpr operator+(MatrixExpr const &lhs, MatrixExpr const &rhs);
+inline MatrixExpr operator-(MatrixExpr const &expr) { return -1.0 * expr; }
+inline MatrixExpr operator-(MatrixExpr const &lhs, MatrixExpr const &rhs) { return lhs + -1.0 * rhs; }
@@ -0,0 +1,345 @@
+#include "scheduler.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+/* CPUs to pin to, from the process mask when pinning went on */
+struct Pinning
+{
+    bool on = false;
+    std::vector<int> cpus;
+};
+
+Pinning &pinning()
+{
+    static Pinning ret;
+    return ret;
+}
+
+void pin_to(std::vector<int> const &cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+}
+
+void pin_thread(size_t index)
+{
+    Pinning const &pin = pinning();
+    if (pin.on)
+    {
+        pin_to({pin.cpus[index % pin.cpus.size()]});
+    }
+}
+
+/* The tasks one thread still owns; padded so the locks do not share lines */
+struct alignas(64) TaskRange
+{
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+class Scheduler
+{
+public:
+    Scheduler(size_t ntask, size_t nthread, std::function<void(size_t)> const &fn)
+        : m_ranges(nthread), m_fn(fn)
+    {
+        for (size_t it = 0; it < nthread; ++it)
+        {
+            m_ranges[it].begin = ntask * it / nthread;
+            m_ranges[it].end = ntask * (it + 1) / nthread;
+        }
+    }
+
+    size_t size() const { return m_ranges.size(); }
+
+    /* Run tasks as thread self, until none are left to take or steal */
+    void work(size_t self)
+    {
+        size_t task;
+        for (;;)
+        {
+            while (pop(self, task))
+            {
+                try
+                {
+                    m_fn(task);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(m_error_mutex);
+                    if (!m_error)
+                    {
+                        m_error = std::current_exception();
+                    }
+                }
+            }
+            if (!steal(self))
+            {
+                return;
+            }
+        }
+    }
+
+    void rethrow() const
+    {
+        if (m_error)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+private:
+    bool pop(size_t self, size_t &task)
+    {
+        TaskRange &range = m_ranges[self];
+        std::lock_guard<std::mutex> lock(range.mutex);
+        if (range.begin == range.end)
+        {
+            return false;
+        }
+        task = range.begin++;
+        return true;
+    }
+
+    /* Move the back half of some other thread's tasks to self */
+    bool steal(size_t self)
+    {
+        size_t nthread = m_ranges.size();
+        for (size_t offset = 1; offset < nthread; ++offset)
+        {
+            TaskRange &victim = m_ranges[(self + offset) % nthread];
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                size_t left = victim.end - victim.begin;
+                if (0 == left)
+                {
+                    continue;
+                }
+                end = victim.end;
+                begin = victim.end -= (left + 1) / 2;
+            }
+            // Only self adds to its own range, and it is empty, so thieves
+            // skip it until this store.
+            TaskRange &range = m_ranges[self];
+            std::lock_guard<std::mutex> lock(range.mutex);
+            range.begin = begin;
+            range.end = end;
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<TaskRange> m_ranges;
+    std::function<void(size_t)> const &m_fn;
+    std::mutex m_error_mutex;
+    std::exception_ptr m_error;
+}; /* end class Scheduler */
+
+/*
+ * Worker threads shared by every parallel_for, started on first use and
+ * added to when a call asks for more; worker it runs as thread it of each
+ * Scheduler that has that many.  One call uses the pool at a time.
+ */
+class WorkerPool
+{
+public:
+    // Never destroyed: it may be used from static destructors, and its
+    // workers just stop with the process.
+    static WorkerPool &instance()
+    {
+        static WorkerPool *ret = new WorkerPool;
+        return *ret;
+    }
+
+    /* False, without running anything, when the pool is taken */
+    bool run(size_t ntask, size_t nthread, std::function<void(size_t)> const &fn)
+    {
+        if (t_in_pool)
+        {
+            return false;
+        }
+        std::unique_lock<std::mutex> busy(m_busy, std::try_to_lock);
+        if (!busy.owns_lock())
+        {
+            return false;
+        }
+        Scheduler job(ntask, nthread, fn);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (; m_nworker + 1 < nthread; ++m_nworker)
+            {
+                std::thread(&WorkerPool::worker, this, m_nworker + 1, m_generation).detach();
+            }
+            m_job = &job;
+            m_pending = nthread - 1;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+
+        t_in_pool = true;
+        sync_pinning(0);
+        job.work(0);
+        t_in_pool = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return 0 == m_pending; });
+            m_job = nullptr;
+        }
+        job.rethrow();
+        return true;
+    }
+
+private:
+    void worker(size_t index, size_t seen)
+    {
+        t_in_pool = true;
+        for (;;)
+        {
+            Scheduler *job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_generation != seen; });
+                seen = m_generation;
+                job = m_job;
+            }
+            if (!job || index >= job->size())
+            {
+                continue;
+            }
+            sync_pinning(index);
+            job->work(index);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (0 == --m_pending)
+            {
+                m_done.notify_all();
+            }
+        }
+    }
+
+    /* Follow set_thread_pinning(), which is only switched between calls */
+    static void sync_pinning(size_t index)
+    {
+        thread_local bool pinned = false;
+        Pinning const &pin = pinning();
+        if (pin.on)
+        {
+            pin_thread(index);
+        }
+        else if (pinned)
+        {
+            pin_to(pin.cpus);
+        }
+        pinned = pin.on;
+    }
+
+    static thread_local bool t_in_pool; // a worker, or a caller inside run()
+
+    std::mutex m_busy;  // held by the call using the pool.
+    std::mutex m_mutex; // guards the job state below.
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    size_t m_nworker = 0;
+    Scheduler *m_job = nullptr;
+    size_t m_pending = 0; // workers still running m_job.
+    size_t m_generation = 0;
+}; /* end class WorkerPool */
+
+thread_local bool WorkerPool::t_in_pool = false;
+
+} /* end namespace */
+
+size_t default_thread_count()
+{
+    if (char const *env = std::getenv("OMP_NUM_THREADS"))
+    {
+        long value = std::strtol(env, nullptr, 10);
+        if (value > 0)
+        {
+            return value;
+        }
+    }
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void parallel_for(size_t ntask, size_t nthread, std::function<void(size_t)> const &fn)
+{
+    nthread = std::min(nthread, ntask);
+    if (nthread < 2)
+    {
+        for (size_t it = 0; it < ntask; ++it)
+        {
+            fn(it);
+        }
+        return;
+    }
+    if (!WorkerPool::instance().run(ntask, nthread, fn))
+    {
+        for (size_t it = 0; it < ntask; ++it)
+        {
+            fn(it);
+        }
+    }
+}
+
+bool set_thread_pinning(bool pin)
+{
+    Pinning &state = pinning();
+#ifdef __linux__
+    if (pin && state.cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (0 == sched_getaffinity(0, sizeof(set), &set))
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                {
+                    state.cpus.push_back(cpu);
+                }
+            }
+        }
+    }
+#endif
+    if (state.cpus.empty())
+    {
+        return !pin;
+    }
+    state.on = pin;
+    if (pin)
+    {
+        pin_thread(0);
+    }
+    else
+    {
+        pin_to(state.cpus);
+    }
+    return true;
+}
+
+bool thread_pinning() { return pinning().on; }
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+/*
+ * Thread count for nthread = 0: OMP_NUM_THREADS when it is set to a positive
+ * number (the first entry of a nested list), else one per hardware thread.
+ */
+size_t default_thread_count();
+
+/*
+ * Call fn(it) for every it in [0, ntask) on nthread threads, the calling
+ * thread being one of them.  Each thread starts on a contiguous share of the
+ * tasks and takes them from the front; a thread that runs dry steals the
+ * back half of another thread's remaining share.  Neighbouring tasks thus
+ * stay on one thread, and uneven tasks (edge tiles, skinny shapes) even out.
+ * The first exception thrown by a task is rethrown after all threads stop.
+ *
+ * The other threads are long-lived workers, so a call costs a wake-up rather
+ * than thread start-up, and their thread_local buffers survive from call to
+ * call.  A call made while another one is running, including one from inside
+ * a task, runs on the calling thread alone.
+ */
+void parallel_for(size_t ntask, size_t nthread, std::function<void(size_t)> const &fn);
+
+/*
+ * With pinning on, the it-th thread of every parallel_for runs on the it-th
+ * CPU of the affinity mask the process had when pinning was switched on
+ * (wrapping around), and the calling thread is pinned to the first.  Off
+ * restores the calling thread's mask.  For benchmarks: switch it between
+ * runs, not during one.  Returns false where affinity is unsupported.
+ */
+bool set_thread_pinning(bool pin);
+bool thread_pinning();
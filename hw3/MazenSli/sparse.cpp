@@ -0,0 +1,176 @@
+#include "sparse.hpp"
+#include "instrument.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+/*
+ * fn(begin, end) over row ranges of mat that hold about equal numbers of
+ * nonzeros, on up to nthread threads; width is the work per nonzero.
+ */
+template <typename Fn>
+void for_row_ranges(SparseMatrix const &mat, size_t width, size_t nthread, Fn const &fn)
+{
+    // Threads only start for enough multiply-adds, and each gets several
+    // ranges so that stealing can even out the rest.
+    size_t const parallel_grain = size_t(1) << 18;
+    size_t const ranges_per_thread = 8;
+
+    if (0 == nthread)
+    {
+        nthread = default_thread_count();
+    }
+    nthread = std::min(nthread, std::max<size_t>(mat.nnz() * std::max<size_t>(width, 1) / parallel_grain, 1));
+    if (1 == nthread)
+    {
+        fn(size_t(0), mat.nrow());
+        return;
+    }
+    size_t nrange = nthread * ranges_per_thread;
+    std::vector<size_t> const &ptr = mat.row_ptr();
+    std::vector<size_t> bounds(nrange + 1, mat.nrow());
+    for (size_t it = 0; it < nrange; ++it)
+    {
+        bounds[it] = std::lower_bound(ptr.begin(), ptr.end() - 1, mat.nnz() * it / nrange) - ptr.begin();
+    }
+    parallel_for(nrange, nthread, [&](size_t it) { fn(bounds[it], bounds[it + 1]); });
+}
+
+} /* end namespace */
+
+SparseMatrix::SparseMatrix(Matrix const &mat)
+    : m_nrow(mat.nrow()), m_ncol(mat.ncol()), m_row_ptr(1, 0)
+{
+    m_row_ptr.reserve(m_nrow + 1);
+    for (size_t it = 0; it < m_nrow; ++it)
+    {
+        double const *row = mat.row(it);
+        for (size_t jt = 0; jt < m_ncol; ++jt)
+        {
+            if (row[jt] != 0)
+            {
+                m_col_idx.push_back(jt);
+                m_values.push_back(row[jt]);
+            }
+        }
+        m_row_ptr.push_back(m_values.size());
+    }
+}
+
+SparseMatrix::SparseMatrix(size_t nrow, size_t ncol, std::vector<size_t> row_ptr, std::vector<size_t> col_idx,
+                           std::vector<double> values)
+    : m_nrow(nrow), m_ncol(ncol), m_row_ptr(std::move(row_ptr)), m_col_idx(std::move(col_idx)),
+      m_values(std::move(values))
+{
+    if (m_row_ptr.size() != m_nrow + 1 || m_row_ptr.front() != 0 || m_row_ptr.back() != m_values.size()
+        || m_col_idx.size() != m_values.size())
+    {
+        throw std::invalid_argument("CSR arrays do not match the shape or each other");
+    }
+    // All of row_ptr first, so that the column checks stay within col_idx.
+    for (size_t it = 0; it < m_nrow; ++it)
+    {
+        if (m_row_ptr[it] > m_row_ptr[it + 1] || m_row_ptr[it + 1] > m_values.size())
+        {
+            throw std::invalid_argument("CSR row_ptr must not decrease");
+        }
+    }
+    for (size_t it = 0; it < m_nrow; ++it)
+    {
+        for (size_t p = m_row_ptr[it]; p < m_row_ptr[it + 1]; ++p)
+        {
+            if (m_col_idx[p] >= m_ncol || (p > m_row_ptr[it] && m_col_idx[p] <= m_col_idx[p - 1]))
+            {
+                throw std::invalid_argument("CSR columns must be in range and increase along a row");
+            }
+        }
+    }
+}
+
+double SparseMatrix::at(size_t row, size_t col) const
+{
+    if (row >= m_nrow || col >= m_ncol)
+    {
+        throw std::out_of_range("SparseMatrix index out of range");
+    }
+    auto begin = m_col_idx.begin() + m_row_ptr[row], end = m_col_idx.begin() + m_row_ptr[row + 1];
+    auto found = std::lower_bound(begin, end, col);
+    return (found != end && *found == col) ? m_values[found - m_col_idx.begin()] : 0;
+}
+
+Matrix SparseMatrix::to_dense() const
+{
+    Matrix ret(m_nrow, m_ncol);
+    for (size_t it = 0; it < m_nrow; ++it)
+    {
+        for (size_t p = m_row_ptr[it]; p < m_row_ptr[it + 1]; ++p)
+            ret(it, m_col_idx[p]) = m_values[p];
+    }
+    return ret;
+}
+
+void spmv(SparseMatrix const &mat, double const *x, double *y, size_t nthread)
+{
+    INSTRUMENT_TIME("spmv");
+    size_t const *ptr = mat.row_ptr().data(), *col = mat.col_idx().data();
+    double const *val = mat.values().data();
+    for_row_ranges(mat, 1, nthread, [&](size_t begin, size_t end) {
+        for (size_t it = begin; it < end; ++it)
+        {
+            double sum = 0;
+            for (size_t p = ptr[it]; p < ptr[it + 1]; ++p)
+                sum += val[p] * x[col[p]];
+            y[it] = sum;
+        }
+    });
+}
+
+std::vector<double> spmv(SparseMatrix const &mat, std::vector<double> const &x, size_t nthread)
+{
+    if (x.size() != mat.ncol())
+    {
+        throw std::out_of_range("the vector size differs from the number of matrix columns");
+    }
+    std::vector<double> ret(mat.nrow());
+    spmv(mat, x.data(), ret.data(), nthread);
+    return ret;
+}
+
+Matrix multiply_sparse(SparseMatrix const &mat1, Matrix const &mat2, size_t nthread)
+{
+    // Output rows are updated a panel of columns at a time, so that the
+    // panel stays in L1 while the rows of mat2 stream past.
+    size_t const panel = 512;
+
+    INSTRUMENT_TIME("multiply_sparse");
+    if (mat1.ncol() != mat2.nrow())
+    {
+        throw std::out_of_range("the number of first matrix column differs from that of second matrix row");
+    }
+    Matrix ret(mat1.nrow(), mat2.ncol());
+    size_t const *ptr = mat1.row_ptr().data(), *col = mat1.col_idx().data();
+    double const *val = mat1.values().data();
+    size_t const n = mat2.ncol();
+    for_row_ranges(mat1, n, nthread, [&](size_t begin, size_t end) {
+        for (size_t it = begin; it < end; ++it)
+        {
+            double *out = ret.row(it);
+            for (size_t j0 = 0; j0 < n; j0 += panel)
+            {
+                size_t j1 = std::min(n, j0 + panel);
+                for (size_t p = ptr[it]; p < ptr[it + 1]; ++p)
+                {
+                    double v = val[p];
+                    double const *in = mat2.row(col[p]);
+                    for (size_t jt = j0; jt < j1; ++jt)
+                        out[jt] += v * in[jt];
+                }
+            }
+        }
+    });
+    return ret;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "matrix.hpp"
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * Sparse matrix of doubles in compressed sparse row (CSR) form: the nonzeros
+ * of row it are values()[p] in column col_idx()[p] for p in
+ * [row_ptr()[it], row_ptr()[it + 1]), with the columns of a row increasing.
+ * Memory is about 16 bytes per nonzero, so it beats Matrix below roughly
+ * half density, and the multiplies below skip the zeros.
+ */
+class SparseMatrix
+{
+public:
+    SparseMatrix() : m_row_ptr(1, 0) {}
+    // The nonzeros of mat; explicit zeros are dropped.
+    explicit SparseMatrix(Matrix const &mat);
+    // From CSR arrays; throws std::invalid_argument if they are inconsistent.
+    SparseMatrix(size_t nrow, size_t ncol, std::vector<size_t> row_ptr, std::vector<size_t> col_idx,
+                 std::vector<double> values);
+
+    // Accessors.
+    size_t nrow() const { return m_nrow; }
+    size_t ncol() const { return m_ncol; }
+    size_t nnz() const { return m_values.size(); }
+    double density() const { return m_nrow && m_ncol ? double(nnz()) / (double(m_nrow) * double(m_ncol)) : 0; }
+    std::vector<size_t> const &row_ptr() const { return m_row_ptr; }
+    std::vector<size_t> const &col_idx() const { return m_col_idx; }
+    std::vector<double> const &values() const { return m_values; }
+    double at(size_t row, size_t col) const; // binary search in the row; throws std::out_of_range.
+
+    Matrix to_dense() const;
+
+private:
+    size_t m_nrow = 0;
+    size_t m_ncol = 0;
+    std::vector<size_t> m_row_ptr;
+    std::vector<size_t> m_col_idx;
+    std::vector<double> m_values;
+}; /* end class SparseMatrix */
+
+/*
+ * Sparse times dense, on nthread threads (0 means default_thread_count()).
+ * Rows are split into tasks of about equal nonzero counts, so uneven rows
+ * balance.  Every element sums its nonzero terms with k increasing, which
+ * for finite operands gives exactly multiply_naive(mat1.to_dense(), mat2)
+ * (unless the compiler is allowed to fuse multiply-adds).  All but the
+ * pointer spmv throw std::out_of_range if the inner dimensions differ.
+ */
+// y = mat * x, where x has mat.ncol() elements and y mat.nrow().
+void spmv(SparseMatrix const &mat, double const *x, double *y, size_t nthread = 0);
+std::vector<double> spmv(SparseMatrix const &mat, std::vector<double> const &x, size_t nthread = 0);
+Matrix multiply_sparse(SparseMatrix const &mat1, Matrix const &mat2, size_t nthread = 0);
@@ -0,0 +1,332 @@
+#include "strassen.hpp"
+#include "gemm.hpp"
+#include "matrix.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+
+size_t &crossover_setting()
+{
+    static size_t ret = 1024;
+    return ret;
+}
+
+size_t round_up(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+/*
+ * Run fn(row) for every row in [0, nrow), in bands of rows over nthread
+ * threads once there is enough work.
+ */
+template <typename Fn>
+void for_rows(size_t nrow, size_t ncol, size_t nthread, Fn &&fn)
+{
+    size_t const band = 64;
+    size_t const parallel_grain = size_t(1) << 18;
+    size_t nband = (nrow + band - 1) / band;
+    nthread = std::min(nthread, std::max<size_t>(nrow * ncol / parallel_grain, 1));
+    if (nthread <= 1)
+    {
+        for (size_t it = 0; it < nrow; ++it)
+            fn(it);
+        return;
+    }
+    parallel_for(nband, nthread, [&](size_t ib) {
+        for (size_t it = ib * band; it < std::min(nrow, (ib + 1) * band); ++it)
+            fn(it);
+    });
+}
+
+/* Bump allocator over a grow-only, per-thread aligned buffer */
+class Arena
+{
+public:
+    explicit Arena(size_t size)
+    {
+        if (buffer().size() < size)
+        {
+            buffer().resize(size);
+        }
+    }
+
+    double *take(size_t size)
+    {
+        double *ret = buffer().data() + m_top;
+        m_top += round_up(size, 8);
+        return ret;
+    }
+    size_t mark() const { return m_top; }
+    void release(size_t mark) { m_top = mark; }
+
+private:
+    static std::vector<double, AlignedAllocator<double>> &buffer()
+    {
+        thread_local std::vector<double, AlignedAllocator<double>> ret;
+        return ret;
+    }
+
+    size_t m_top = 0;
+}; /* end class Arena */
+
+/* Temporaries of all the levels below an m x k times k x n product */
+size_t level_space(size_t m, size_t k, size_t n, size_t levels)
+{
+    size_t ret = 0;
+    for (; levels > 0; --levels)
+    {
+        m /= 2;
+        k /= 2;
+        n /= 2;
+        ret += m * round_up(k, 8) + k * round_up(n, 8) + m * round_up(n, 8);
+    }
+    return ret;
+}
+
+class Strassen
+{
+public:
+    Strassen(Arena &arena, size_t nthread) : m_arena(arena), m_nthread(nthread) {}
+
+    // c = a * b; m, k and n are multiples of 2^levels.
+    void multiply(double const *a, size_t lda, double const *b, size_t ldb, double *c, size_t ldc,
+                  size_t m, size_t k, size_t n, size_t levels)
+    {
+        if (0 == levels)
+        {
+            gemm(m, n, k, a, lda, b, ldb, c, ldc, m_nthread);
+            return;
+        }
+        size_t hm = m / 2, hk = k / 2, hn = n / 2;
+        double const *a11 = a, *a12 = a + hk, *a21 = a + hm * lda, *a22 = a21 + hk;
+        double const *b11 = b, *b12 = b + hn, *b21 = b + hk * ldb, *b22 = b21 + hn;
+        double *c11 = c, *c12 = c + hn, *c21 = c + hm * ldc, *c22 = c21 + hn;
+
+        size_t mark = m_arena.mark();
+        size_t lta = round_up(hk, 8), ltb = round_up(hn, 8), ltm = round_up(hn, 8);
+        double *ta = m_arena.take(hm * lta);
+        double *tb = m_arena.take(hk * ltb);
+        double *tm = m_arena.take(hm * ltm);
+        auto product = [&](double const *x, size_t ldx, double const *y, size_t ldy) {
+            multiply(x, ldx, y, ldy, tm, ltm, hm, hk, hn, levels - 1);
+        };
+        auto a_sum = [&](double const *x, double const *y, double sign) { combine(hm, hk, x, lda, y, lda, sign, ta, lta); };
+        auto b_sum = [&](double const *x, double const *y, double sign) { combine(hk, hn, x, ldb, y, ldb, sign, tb, ltb); };
+        auto to_c = [&](double *dst, double sign, bool overwrite) { update(hm, hn, tm, ltm, sign, dst, ldc, overwrite); };
+
+        // M1 = (A11 + A22)(B11 + B22) goes to C11 and C22.
+        a_sum(a11, a22, 1);
+        b_sum(b11, b22, 1);
+        product(ta, lta, tb, ltb);
+        to_c(c11, 1, true);
+        to_c(c22, 1, true);
+        // M2 = (A21 + A22) B11 goes to C21, and from C22.
+        a_sum(a21, a22, 1);
+        product(ta, lta, b11, ldb);
+        to_c(c21, 1, true);
+        to_c(c22, -1, false);
+        // M3 = A11 (B12 - B22) goes to C12 and C22.
+        b_sum(b12, b22, -1);
+        product(a11, lda, tb, ltb);
+        to_c(c12, 1, true);
+        to_c(c22, 1, false);
+        // M4 = A22 (B21 - B11) goes to C11 and C21.
+        b_sum(b21, b11, -1);
+        product(a22, lda, tb, ltb);
+        to_c(c11, 1, false);
+        to_c(c21, 1, false);
+        // M5 = (A11 + A12) B22 goes from C11 and to C12.
+        a_sum(a11, a12, 1);
+        product(ta, lta, b22, ldb);
+        to_c(c11, -1, false);
+        to_c(c12, 1, false);
+        // M6 = (A21 - A11)(B11 + B12) goes to C22.
+        a_sum(a21, a11, -1);
+        b_sum(b11, b12, 1);
+        product(ta, lta, tb, ltb);
+        to_c(c22, 1, false);
+        // M7 = (A12 - A22)(B21 + B22) goes to C11.
+        a_sum(a12, a22, -1);
+        b_sum(b21, b22, 1);
+        product(ta, lta, tb, ltb);
+        to_c(c11, 1, false);
+
+        m_arena.release(mark);
+    }
+
+private:
+    // z = x + sign * y
+    void combine(size_t nrow, size_t ncol, double const *x, size_t ldx, double const *y, size_t ldy,
+                 double sign, double *z, size_t ldz)
+    {
+        for_rows(nrow, ncol, m_nthread, [&](size_t it) {
+            double const *xr = x + it * ldx, *yr = y + it * ldy;
+            double *zr = z + it * ldz;
+            for (size_t jt = 0; jt < ncol; ++jt)
+                zr[jt] = xr[jt] + sign * yr[jt];
+        });
+    }
+
+    // dst = sign * src, or dst += sign * src
+    void update(size_t nrow, size_t ncol, double const *src, size_t lds, double sign, double *dst, size_t ldd,
+                bool overwrite)
+    {
+        for_rows(nrow, ncol, m_nthread, [&](size_t it) {
+            double const *sr = src + it * lds;
+            double *dr = dst + it * ldd;
+            if (overwrite)
+            {
+                for (size_t jt = 0; jt < ncol; ++jt)
+                    dr[jt] = sign * sr[jt];
+            }
+            else
+            {
+                for (size_t jt = 0; jt < ncol; ++jt)
+                    dr[jt] += sign * sr[jt];
+            }
+        });
+    }
+
+    Arena &m_arena;
+    size_t m_nthread;
+}; /* end class Strassen */
+
+/* Copy an nrow x ncol block into a zero-padded prow x pcol one */
+void copy_padded(double const *src, size_t lds, size_t nrow, size_t ncol, double *dst, size_t ldd,
+                 size_t prow, size_t pcol)
+{
+    for (size_t it = 0; it < prow; ++it)
+    {
+        double *dr = dst + it * ldd;
+        if (it < nrow)
+        {
+            std::copy(src + it * lds, src + it * lds + ncol, dr);
+            std::fill(dr + ncol, dr + pcol, 0.0);
+        }
+        else
+        {
+            std::fill(dr, dr + pcol, 0.0);
+        }
+    }
+}
+
+Matrix random_square(size_t size, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> dist(-1, 1);
+    Matrix ret(size, size);
+    for (size_t it = 0; it < size; ++it)
+    {
+        for (size_t jt = 0; jt < size; ++jt)
+            ret(it, jt) = dist(rng);
+    }
+    return ret;
+}
+
+/* Best of a few runs, in seconds */
+template <typename Fn>
+double best_time(Fn &&fn)
+{
+    double ret = 0;
+    for (size_t it = 0; it < 3; ++it)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ret = 0 == it ? elapsed : std::min(ret, elapsed);
+    }
+    return ret;
+}
+
+} /* end namespace */
+
+void strassen(size_t m, size_t n, size_t k, double const *a, size_t lda, double const *b, size_t ldb,
+              double *c, size_t ldc, size_t nthread, size_t crossover)
+{
+    if (0 == crossover)
+    {
+        crossover = strassen_crossover();
+    }
+    if (0 == nthread)
+    {
+        nthread = default_thread_count();
+    }
+    size_t levels = 0;
+    while (std::min({m, n, k}) >> levels > crossover)
+    {
+        ++levels;
+    }
+    if (0 == levels)
+    {
+        gemm(m, n, k, a, lda, b, ldb, c, ldc, nthread);
+        return;
+    }
+
+    size_t align = size_t(1) << levels;
+    size_t pm = round_up(m, align), pk = round_up(k, align), pn = round_up(n, align);
+    bool padded = pm != m || pk != k || pn != n;
+    size_t pad_space = padded ? pm * round_up(pk, 8) + pk * round_up(pn, 8) + pm * round_up(pn, 8) : 0;
+    Arena arena(pad_space + level_space(pm, pk, pn, levels));
+    Strassen run(arena, nthread);
+    if (!padded)
+    {
+        run.multiply(a, lda, b, ldb, c, ldc, m, k, n, levels);
+        return;
+    }
+
+    size_t lpa = round_up(pk, 8), lpb = round_up(pn, 8), lpc = round_up(pn, 8);
+    double *pa = arena.take(pm * lpa);
+    double *pb = arena.take(pk * lpb);
+    double *pc = arena.take(pm * lpc);
+    copy_padded(a, lda, m, k, pa, lpa, pm, pk);
+    copy_padded(b, ldb, k, n, pb, lpb, pk, pn);
+    run.multiply(pa, lpa, pb, lpb, pc, lpc, pm, pk, pn, levels);
+    for (size_t it = 0; it < m; ++it)
+    {
+        std::copy(pc + it * lpc, pc + it * lpc + n, c + it * ldc);
+    }
+}
+
+size_t strassen_crossover() { return crossover_setting(); }
+
+void set_strassen_crossover(size_t crossover)
+{
+    if (0 == crossover)
+    {
+        throw std::invalid_argument("Strassen crossover must be positive");
+    }
+    crossover_setting() = crossover;
+}
+
+StrassenTuning tune_strassen(size_t max_size, size_t nthread)
+{
+    StrassenTuning ret{max_size, {}, {}, {}, 0};
+    std::mt19937 rng(0);
+    for (size_t size = 128; 2 * size <= max_size; size *= 2)
+    {
+        Matrix mat1 = random_square(2 * size, rng), mat2 = random_square(2 * size, rng);
+        Matrix out(2 * size, 2 * size);
+        auto run = [&](size_t crossover) {
+            strassen(out.nrow(), out.ncol(), mat1.ncol(), mat1.data(), mat1.ld(), mat2.data(), mat2.ld(),
+                     out.data(), out.ld(), nthread, crossover);
+        };
+        ret.sizes.push_back(size);
+        ret.gemm_seconds.push_back(best_time([&] { run(2 * size); }));
+        ret.strassen_seconds.push_back(best_time([&] { run(size); }));
+        if (ret.strassen_seconds.back() < ret.gemm_seconds.back())
+        {
+            ret.crossover = size;
+            break;
+        }
+    }
+    set_strassen_crossover(ret.crossover);
+
+    Matrix mat1 = random_square(512, rng), mat2 = random_square(512, rng);
+    Matrix out(512, 512);
+    strassen(512, 512, 512, mat1.data(), mat1.ld(), mat2.data(), mat2.ld(), out.data(), out.ld(), nthread, 64);
+    ret.max_error = max_relative_error(out, multiply_naive(mat1, mat2));
+    return ret;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * c = a * b by Strassen's recursion, with gemm() below the crossover; the
+ * arguments are those of gemm().  The recursion splits while the smallest
+ * of m, n and k is above crossover (0 means strassen_crossover()); each
+ * dimension is zero-padded to a multiple of 2^levels once, at the top, so
+ * odd sizes cost at most 2^levels - 1 extra rows or columns.  The padded
+ * copies and the temporaries of every level come from one per-thread arena
+ * that later calls reuse.
+ *
+ * Accuracy: each level adds and subtracts blocks before multiplying, so the
+ * error is bounded normwise rather than elementwise and grows by a factor
+ * of up to 12 per level in the worst case, much less in practice.  For
+ * 512 x 512 uniform [-1, 1) matrices, max_relative_error() against
+ * multiply_naive is 2e-15 with gemm() alone and 4e-15 after three levels;
+ * tune_strassen() reports it on the machine.  Small integers stay exact.
+ */
+void strassen(size_t m, size_t n, size_t k, double const *a, size_t lda, double const *b, size_t ldb,
+              double *c, size_t ldc, size_t nthread = 0, size_t crossover = 0);
+
+// Crossover used when none is given: 1024 until set or tuned.
+size_t strassen_crossover();
+void set_strassen_crossover(size_t crossover); // throws std::invalid_argument for 0.
+
+/* Result of tune_strassen() */
+struct StrassenTuning
+{
+    size_t crossover;                     // the pick, now in effect
+    std::vector<size_t> sizes;            // crossovers tried, doubling from 128
+    std::vector<double> gemm_seconds;     // gemm() of 2 * size square matrices
+    std::vector<double> strassen_seconds; // one level with gemm() leaves of size
+    double max_error;                     // three levels on 512 x 512 versus multiply_naive
+};
+
+/*
+ * Time one Strassen level against gemm() at doubling sizes and make the
+ * smallest size at which the level wins the crossover.  When it never wins
+ * up to max_size, the crossover is set to max_size so that only larger,
+ * untried sizes recurse.  Takes a few seconds at the default max_size.
+ */
+StrassenTuning tune_strassen(size_t max_size = 2048, size_t nthread = 0);
@@ -0,0 +1,495 @@
+import random
+import unittest
+
+import _matrix
+
+
+def make_matrix(nrow, ncol, fill):
+    mat = _matrix.Matrix(nrow, ncol)
+    for it in range(nrow):
+        for jt in range(ncol):
+            mat[it, jt] = fill(it, jt)
+    return mat
+
+
+def random_matrix(nrow, ncol, rng):
+    return make_matrix(nrow, ncol, lambda it, jt: rng.uniform(-1, 1))
+
+
+class testMatrix(unittest.TestCase):
+
+    def test_basic(self):
+        mat = make_matrix(3, 4, lambda it, jt: it * 4 + jt + 1)
+        assert mat.nrow == 3
+        assert mat.ncol == 4
+        assert mat[0, 1] == 2
+        assert mat[2, 3] == 12
+        assert mat == make_matrix(3, 4, lambda it, jt: it * 4 + jt + 1)
+        mat[2, 3] = 0
+        assert mat != make_matrix(3, 4, lambda it, jt: it * 4 + jt + 1)
+        assert _matrix.Matrix(2, 2)[1, 1] == 0
+
+    def test_padding(self):
+        for ncol, ld in [(0, 0), (1, 8), (8, 8), (1000, 1000), (1021, 1024), (1024, 1032)]:
+            assert _matrix.Matrix(3, ncol).ld == ld
+
+    def test_buffer_is_view(self):
+        import numpy as np
+        mat = _matrix.Matrix(3, 5)
+        arr = np.asarray(mat)
+        assert arr.shape == (3, 5)
+        assert arr.dtype == np.float64
+        assert arr.strides == (8 * 8, 8)
+        assert arr.ctypes.data % 64 == 0
+        arr[1, 2] = 7
+        assert mat[1, 2] == 7
+        mat[2, 4] = 3
+        assert arr[2, 4] == 3
+        ret = _matrix.multiply_mkl(mat, _matrix.Matrix(5, 2))
+        assert (np.asarray(ret) == 0).all()
+
+    def test_float_matrix(self):
+        import numpy as np
+        mat = _matrix.FloatMatrix(3, 17)
+        assert mat.ld == 32
+        arr = np.asarray(mat)
+        assert arr.dtype == np.float32
+        assert arr.strides == (32 * 4, 4)
+        mat.iota(0, 0.5)
+        assert mat[2, 16] == 25
+        mat[0, :] = 0.1
+        assert mat[0, 3] == np.float32(0.1)
+        assert _matrix.FloatMatrix.from_numpy(arr) == mat
+
+    def test_fill_iota(self):
+        mat = _matrix.Matrix(3, 4)
+        mat.iota(1)
+        assert mat == make_matrix(3, 4, lambda it, jt: it * 4 + jt + 1)
+        mat.iota(start=2, step=0.5)
+        assert mat[2, 3] == 2 + 11 * 0.5
+        mat.fill(7)
+        assert mat == make_matrix(3, 4, lambda it, jt: 7)
+
+    def test_from_numpy(self):
+        import numpy as np
+        src = np.arange(12, dtype=np.float64).reshape(3, 4)
+        mat = _matrix.Matrix.from_numpy(src)
+        assert mat.nrow == 3 and mat.ncol == 4
+        assert (np.asarray(mat) == src).all()
+        assert (np.asarray(_matrix.Matrix.from_numpy(src.T)) == src.T).all()
+        assert (np.asarray(_matrix.Matrix.from_numpy(src[:, ::2].astype(np.int32))) == src[:, ::2]).all()
+        with self.assertRaises(ValueError):
+            _matrix.Matrix.from_numpy(np.zeros(3))
+
+    def test_slice_assignment(self):
+        import numpy as np
+        mat = _matrix.Matrix(4, 5)
+        mat[1, :] = np.arange(5)
+        mat[:, 4] = [9, 8, 7, 6]
+        mat[2:4, 0:2] = np.array([[1, 2], [3, 4]])
+        mat[3, ::2] = -1
+        mat[-1, 1] = 5
+        ref = np.zeros((4, 5))
+        ref[1, :] = np.arange(5)
+        ref[:, 4] = [9, 8, 7, 6]
+        ref[2:4, 0:2] = [[1, 2], [3, 4]]
+        ref[3, ::2] = -1
+        ref[-1, 1] = 5
+        assert (np.asarray(mat) == ref).all()
+        with self.assertRaises(ValueError):
+            mat[1, :] = np.arange(4)
+        with self.assertRaises(IndexError):
+            mat[4, :] = 0
+
+    def test_index_error(self):
+        mat = _matrix.Matrix(2, 3)
+        with self.assertRaises(IndexError):
+            mat[2, 0]
+        with self.assertRaises(IndexError):
+            mat[0, 3] = 1
+        with self.assertRaises(IndexError):
+            mat[-3, 0]
+        with self.assertRaises(ValueError):
+            mat[0, :]
+
+    def test_negative_index(self):
+        mat = make_matrix(2, 3, lambda it, jt: it * 3 + jt)
+        assert mat[-1, 0] == 3 and mat[-1, -1] == mat[1, 2] == 5
+        fmat = _matrix.FloatMatrix(2, 3)
+        fmat[-2, -3] = 7
+        assert fmat[0, 0] == fmat[-2, 0] == 7
+
+
+class testMultiply(unittest.TestCase):
+
+    def test_match(self):
+        size = 100
+        mat1 = make_matrix(size, size, lambda it, jt: it * size + jt + 1)
+        mat2 = make_matrix(size, size, lambda it, jt: it * size + jt + 1)
+        ret_naive = _matrix.multiply_naive(mat1, mat2)
+        ret_mkl = _matrix.multiply_mkl(mat1, mat2)
+        assert ret_naive.nrow == size and ret_naive.ncol == size
+        assert ret_naive == ret_mkl
+
+    def test_shape_mismatch(self):
+        with self.assertRaises(IndexError):
+            _matrix.multiply_naive(_matrix.Matrix(2, 3), _matrix.Matrix(2, 3))
+        with self.assertRaises(IndexError):
+            _matrix.multiply_mkl(_matrix.Matrix(2, 3), _matrix.Matrix(2, 3))
+        with self.assertRaises(IndexError):
+            _matrix.multiply_tile(_matrix.Matrix(2, 3), _matrix.Matrix(2, 3), 16)
+
+    def test_tile_match(self):
+        # Not integers: the tiled sums must round exactly like the naive ones.
+        rng = random.Random(0)
+        for shape in [(37, 53, 41), (64, 64, 64), (1, 70, 3), (90, 1, 90)]:
+            mat1 = random_matrix(shape[0], shape[1], rng)
+            mat2 = random_matrix(shape[1], shape[2], rng)
+            ret_naive = _matrix.multiply_naive(mat1, mat2)
+            for tsize in [1, 7, 16, 100]:
+                for order in ["ijk", "ikj", "jik", "jki", "kij", "kji"]:
+                    assert _matrix.multiply_tile(mat1, mat2, tsize, order) == ret_naive, (shape, tsize, order)
+
+    def test_parallel_match(self):
+        rng = random.Random(1)
+        for shape in [(300, 200, 310), (1, 400, 700), (700, 3, 1), (129, 129, 129)]:
+            mat1 = random_matrix(shape[0], shape[1], rng)
+            mat2 = random_matrix(shape[1], shape[2], rng)
+            ret_naive = _matrix.multiply_naive(mat1, mat2)
+            for nthread in [1, 2, 3, 8]:
+                assert _matrix.multiply_parallel(mat1, mat2, nthread) == ret_naive, (shape, nthread)
+            assert _matrix.multiply_parallel(mat1, mat2, tsize=17) == ret_naive
+
+    def test_simd_match(self):
+        rng = random.Random(2)
+        isa = _matrix.gemm_isa()
+        try:
+            for name in ["scalar", "avx2", "avx512"]:
+                if not _matrix.set_gemm_isa(name):
+                    continue
+                for shape in [(300, 200, 310), (1, 400, 700), (700, 3, 1), (97, 300, 131)]:
+                    mat1 = random_matrix(shape[0], shape[1], rng)
+                    mat2 = random_matrix(shape[1], shape[2], rng)
+                    ret_naive = _matrix.multiply_naive(mat1, mat2)
+                    ret = _matrix.multiply_simd(mat1, mat2, 2)
+                    assert ret.nrow == shape[0] and ret.ncol == shape[2]
+                    for it in range(ret.nrow):
+                        for jt in range(ret.ncol):
+                            self.assertAlmostEqual(ret[it, jt], ret_naive[it, jt], delta=1e-12 * shape[1])
+        finally:
+            _matrix.set_gemm_isa(isa)
+        assert not _matrix.set_gemm_isa("sse9")
+
+    def test_simd_integers(self):
+        size = 100
+        mat1 = make_matrix(size, size, lambda it, jt: it * size + jt + 1)
+        assert _matrix.multiply_simd(mat1, mat1) == _matrix.multiply_naive(mat1, mat1)
+
+    def test_strassen_match(self):
+        rng = random.Random(4)
+        for shape in [(300, 200, 310), (129, 129, 129), (97, 300, 131), (1, 70, 3)]:
+            mat1 = random_matrix(shape[0], shape[1], rng)
+            mat2 = random_matrix(shape[1], shape[2], rng)
+            ret_naive = _matrix.multiply_naive(mat1, mat2)
+            for crossover in [7, 16, 64, 1000]:
+                ret = _matrix.multiply_strassen(mat1, mat2, 2, crossover)
+                error = _matrix.max_relative_error(ret, ret_naive)
+                assert error < 1e-13, (shape, crossover, error)
+        mat1 = make_matrix(100, 100, lambda it, jt: (it * 7 + jt) % 5 - 2)
+        assert _matrix.multiply_strassen(mat1, mat1, crossover=8) == _matrix.multiply_naive(mat1, mat1)
+        with self.assertRaises(IndexError):
+            _matrix.multiply_strassen(_matrix.Matrix(2, 3), _matrix.Matrix(2, 3))
+
+    def test_strassen_tuning(self):
+        crossover = _matrix.strassen_crossover()
+        try:
+            tuning = _matrix.tune_strassen(512)
+            assert tuning.crossover == _matrix.strassen_crossover()
+            assert tuning.sizes == [128, 256][:len(tuning.sizes)]
+            assert len(tuning.gemm_seconds) == len(tuning.strassen_seconds) == len(tuning.sizes)
+            assert 0 < tuning.max_error < 1e-13
+        finally:
+            _matrix.set_strassen_crossover(crossover)
+        with self.assertRaises(ValueError):
+            _matrix.set_strassen_crossover(0)
+
+    def test_dispatch(self):
+        rng = random.Random(5)
+        for shape in [(30, 20, 31), (300, 200, 310), (1000, 8, 900), (8, 700, 9)]:
+            mat1 = random_matrix(shape[0], shape[1], rng)
+            mat2 = random_matrix(shape[1], shape[2], rng)
+            ret_naive = _matrix.multiply_naive(mat1, mat2)
+            for nthread in [1, 2]:
+                assert _matrix.multiply_backend(*shape, nthread) in ("mkl", "simd", "strassen")
+                error = _matrix.max_relative_error(_matrix.multiply(mat1, mat2, nthread), ret_naive)
+                assert error < 1e-13, (shape, nthread, error)
+        with self.assertRaises(IndexError):
+            _matrix.multiply(_matrix.Matrix(2, 3), _matrix.Matrix(2, 3))
+
+    def test_tuning_file(self):
+        import os
+        import tempfile
+        crossover = _matrix.strassen_crossover()
+        with tempfile.TemporaryDirectory() as tmp:
+            path = os.path.join(tmp, "cache", "host.tuning")
+            try:
+                _matrix.tune_multiply(256)
+                _matrix.save_tuning(path)
+                shapes = [(64, 64, 64, 1), (256, 256, 256, 1), (256, 256, 256, 2)]
+                picks = [_matrix.multiply_backend(*shape) for shape in shapes]
+                assert _matrix.load_tuning(path)
+                assert picks == [_matrix.multiply_backend(*shape) for shape in shapes]
+                with open(path) as fobj:
+                    lines = fobj.read().splitlines()
+                assert lines[0] == "matrix-tuning 1"
+                with open(path, "w") as fobj:
+                    fobj.write("\n".join(["matrix-tuning 1", "cpu other/1"] + lines[2:]) + "\n")
+                assert not _matrix.load_tuning(path)
+                # Measured at another thread budget.
+                threads = int(lines[2].split()[1])
+                with open(path, "w") as fobj:
+                    fobj.write("\n".join(lines[:2] + ["threads %d" % (threads + 1)] + lines[3:]) + "\n")
+                assert not _matrix.load_tuning(path)
+                with open(path, "w") as fobj:
+                    fobj.write("\n".join(lines) + "\n")
+                assert _matrix.load_tuning(path)
+                assert not _matrix.load_tuning(os.path.join(tmp, "missing"))
+            finally:
+                _matrix.set_strassen_crossover(crossover)
+
+    def test_float_match(self):
+        import numpy as np
+        rng = np.random.default_rng(0)
+        arr1 = rng.integers(-8, 8, (37, 53)).astype(np.float32) / 4
+        arr2 = rng.integers(-8, 8, (53, 41)).astype(np.float32) / 8
+        mat1 = _matrix.FloatMatrix.from_numpy(arr1)
+        mat2 = _matrix.FloatMatrix.from_numpy(arr2)
+        ret = _matrix.multiply_naive(mat1, mat2)
+        assert isinstance(ret, _matrix.FloatMatrix)
+        assert (np.asarray(ret) == arr1 @ arr2).all()
+        assert _matrix.multiply_mkl(mat1, mat2) == ret
+        assert _matrix.multiply_tile(mat1, mat2, 16, "kji") == ret
+        with self.assertRaises(IndexError):
+            _matrix.multiply_naive(mat1, mat1)
+
+    def test_batched(self):
+        import numpy as np
+        rng = np.random.default_rng(1)
+        for m, k, n in [(3, 3, 3), (4, 4, 4), (8, 8, 8), (5, 7, 2), (1, 9, 1), (3, 0, 3)]:
+            for dtype in [np.float32, np.float64]:
+                a = rng.integers(-8, 8, (300, m, k)).astype(dtype) / 4
+                b = rng.integers(-8, 8, (300, k, n)).astype(dtype) / 8
+                ret = _matrix.multiply_batched(a, b)
+                assert ret.dtype == dtype
+                assert ret.shape == (300, m, n)
+                assert (ret == a @ b).all(), (m, k, n, dtype)
+        # Strided and transposed operands.
+        a = rng.uniform(-1, 1, (50, 8, 16))[:, :, ::2]
+        b = rng.uniform(-1, 1, (8, 8, 50)).transpose(2, 0, 1)
+        assert np.allclose(_matrix.multiply_batched(a, b, nthread=2), a @ b, rtol=0, atol=1e-13)
+        with self.assertRaises(IndexError):
+            _matrix.multiply_batched(np.zeros((2, 3, 3)), np.zeros((2, 4, 3)))
+        with self.assertRaises(ValueError):
+            _matrix.multiply_batched(np.zeros((3, 3)), np.zeros((3, 3)))
+
+    def test_tile_arguments(self):
+        mat = _matrix.Matrix(4, 4)
+        with self.assertRaises(ValueError):
+            _matrix.multiply_tile(mat, mat, 0)
+        with self.assertRaises(ValueError):
+            _matrix.multiply_tile(mat, mat, 2, "ijj")
+
+
+class testSparse(unittest.TestCase):
+
+    def sparse_matrix(self, nrow, ncol, rng, density=0.05):
+        return make_matrix(nrow, ncol, lambda it, jt: rng.uniform(-1, 1) if rng.random() < density else 0)
+
+    def test_convert(self):
+        mat = self.sparse_matrix(40, 30, random.Random(5))
+        sparse = _matrix.SparseMatrix(mat)
+        assert sparse.nrow == 40 and sparse.ncol == 30
+        assert sparse.nnz == sum(mat[it, jt] != 0 for it in range(40) for jt in range(30))
+        assert len(sparse.row_ptr) == 41 and len(sparse.values) == sparse.nnz
+        assert sparse.to_dense() == mat
+        assert all(sparse[it, jt] == mat[it, jt] for it in range(40) for jt in range(30))
+        copy = _matrix.SparseMatrix(40, 30, sparse.row_ptr, sparse.col_idx, sparse.values)
+        assert copy.to_dense() == mat
+        with self.assertRaises(ValueError):
+            _matrix.SparseMatrix(2, 2, [0, 2, 2], [1, 0], [1.0, 2.0])
+        with self.assertRaises(ValueError):
+            _matrix.SparseMatrix(2, 4, [0, 5, 2], [0, 1], [1.0, 2.0])
+        with self.assertRaises(IndexError):
+            sparse[40, 0]
+        assert sparse[-1, -1] == mat[39, 29]
+
+    def test_multiply(self):
+        # The nonzero terms are summed in the naive order, so results match exactly.
+        rng = random.Random(6)
+        for shape in [(37, 53, 41), (200, 300, 3), (1, 64, 90), (5, 0, 3)]:
+            mat1 = self.sparse_matrix(shape[0], shape[1], rng)
+            mat2 = random_matrix(shape[1], shape[2], rng)
+            ref = _matrix.multiply_naive(mat1, mat2)
+            for nthread in [1, 3]:
+                assert _matrix.multiply_sparse(_matrix.SparseMatrix(mat1), mat2, nthread) == ref, shape
+        with self.assertRaises(IndexError):
+            _matrix.multiply_sparse(_matrix.SparseMatrix(_matrix.Matrix(2, 3)), _matrix.Matrix(2, 3))
+
+    def test_spmv(self):
+        import numpy as np
+        mat = self.sparse_matrix(300, 200, random.Random(7))
+        x = np.linspace(-1, 1, 200)
+        y = _matrix.spmv(_matrix.SparseMatrix(mat), x, nthread=2)
+        assert y.shape == (300,)
+        assert np.allclose(y, np.asarray(mat) @ x, rtol=0, atol=1e-14)
+        with self.assertRaises(IndexError):
+            _matrix.spmv(_matrix.SparseMatrix(mat), np.zeros(3))
+
+    def test_validate_matrices(self):
+        # The operands of validate.py, one of them made sparse.
+        size = 100
+        mat1 = make_matrix(size, size, lambda it, jt: it * size + jt + 1 if (it + jt) % 10 == 0 else 0)
+        mat2 = make_matrix(size, size, lambda it, jt: it * size + jt + 1)
+        assert _matrix.multiply_sparse(_matrix.SparseMatrix(mat1), mat2) == _matrix.multiply_mkl(mat1, mat2)
+
+
+class testMappedMatrix(unittest.TestCase):
+
+    def setUp(self):
+        import tempfile
+        self.tmpdir = tempfile.TemporaryDirectory()
+
+    def tearDown(self):
+        self.tmpdir.cleanup()
+
+    def path(self, name):
+        import os
+        return os.path.join(self.tmpdir.name, name)
+
+    def test_roundtrip(self):
+        mat = make_matrix(37, 21, lambda it, jt: it * 21 + jt)
+        mapped = _matrix.MappedMatrix.create(self.path("a"), mat, tile=16)
+        assert (mapped.nrow, mapped.ncol, mapped.tile) == (37, 21, 16)
+        assert mapped[36, 20] == mapped[-1, -1] == 36 * 21 + 20
+        mapped[-36, 2] = -1
+        mapped.flush()
+        del mapped
+        mapped = _matrix.MappedMatrix.open(self.path("a"))
+        assert not mapped.writable
+        mat[1, 2] = -1
+        assert mapped.to_matrix() == mat
+        with self.assertRaises(ValueError):
+            mapped[0, 0] = 1
+        with self.assertRaises(IndexError):
+            mapped[37, 0]
+        with self.assertRaises(RuntimeError):
+            _matrix.MappedMatrix.open(self.path("missing"))
+
+    def test_bad_header(self):
+        import struct
+        # 2^61 rows of 8 bytes wrap to a header-only file length.
+        with open(self.path("a"), "wb") as f:
+            f.write(struct.pack("=8sQQQ", b"NSDHWMM1", 2 ** 61, 1, 1).ljust(4096, b"\0"))
+        with self.assertRaises(RuntimeError):
+            _matrix.MappedMatrix.open(self.path("a"))
+        # A size that is refused leaves an existing file alone.
+        _matrix.MappedMatrix.create(self.path("b"), make_matrix(3, 2, lambda it, jt: it - jt), tile=2)
+        with self.assertRaises(ValueError):
+            _matrix.MappedMatrix.create(self.path("b"), 2 ** 61, 1, tile=1)
+        with self.assertRaises(ValueError):
+            _matrix.MappedMatrix.create(self.path("b"), 2, 2, tile=0)
+        mapped = _matrix.MappedMatrix.open(self.path("b"))
+        assert (mapped.nrow, mapped.ncol) == (3, 2) and mapped[2, 0] == 2
+
+    def test_multiply(self):
+        rng = random.Random(4)
+        for shape, tile in [((37, 53, 41), 16), ((64, 64, 64), 32), ((5, 0, 7), 4), ((70, 90, 30), 512)]:
+            mat1 = random_matrix(shape[0], shape[1], rng)
+            mat2 = random_matrix(shape[1], shape[2], rng)
+            mapped1 = _matrix.MappedMatrix.create(self.path("a"), mat1, tile)
+            mapped2 = _matrix.MappedMatrix.create(self.path("b"), mat2, tile)
+            ret = _matrix.multiply_out_of_core(mapped1, mapped2, self.path("c"), nthread=2)
+            ref = _matrix.multiply_naive(mat1, mat2)
+            assert _matrix.max_relative_error(ret.to_matrix(), ref) < 1e-14, (shape, tile)
+        with self.assertRaises(IndexError):
+            _matrix.multiply_out_of_core(mapped1, mapped1, self.path("c"))
+        with self.assertRaises(ValueError):
+            _matrix.multiply_out_of_core(mapped1, mapped2, self.path("a"))
+
+
+class testExpr(unittest.TestCase):
+
+    # Small integers: every evaluation order gives the exact product.
+    def setUp(self):
+        rng = random.Random(3)
+        self.mats = {name: make_matrix(nrow, ncol, lambda it, jt: rng.randint(-3, 3))
+                     for name, nrow, ncol in [("a", 37, 5), ("b", 5, 41), ("c", 41, 3), ("d", 37, 3), ("e", 37, 41)]}
+
+    def test_chain(self):
+        a, b, c = self.mats["a"], self.mats["b"], self.mats["c"]
+        ref = _matrix.multiply_naive(_matrix.multiply_naive(a, b), c)
+        expr = a * b * c
+        assert isinstance(expr, _matrix.MatrixExpr)
+        assert (expr.nrow, expr.ncol) == (37, 3)
+        assert expr.eval() == ref
+        assert (a @ (b @ c)).eval() == ref
+
+    def test_fused(self):
+        a, b, c, d, e = (self.mats[name] for name in "abcde")
+        ab = _matrix.multiply_naive(a, b)
+        expect = _matrix.Matrix(37, 3)
+        abcd = _matrix.multiply_naive(ab, c)
+        for it in range(37):
+            for jt in range(3):
+                expect[it, jt] = 2 * abcd[it, jt] - d[it, jt]
+        assert (2 * (a * b * c) - d).eval() == expect
+        nested = ((a * (b + b)) * c).eval()
+        assert nested == (2 * abcd).eval()
+        assert (e - e).eval() == _matrix.Matrix(37, 41)
+        assert (-ab + ab * 1).eval() == _matrix.Matrix(37, 41)
+
+    def test_out(self):
+        a, b, c, d = (self.mats[name] for name in "abcd")
+        ref = (a * b * c + d).eval()
+        out = _matrix.Matrix(37, 3)
+        assert (a * b * c + d).eval(out=out) is out
+        assert out == ref
+        with self.assertRaises(ValueError):
+            (a * b * c).eval(out=_matrix.Matrix(3, 37))
+        # The destination may be an operand.
+        dd = (d * 1).eval()
+        (a * b * c + dd).eval(out=dd)
+        assert dd == ref
+        sq = make_matrix(4, 4, lambda it, jt: it - jt)
+        sq2 = _matrix.multiply_naive(sq, sq)
+        (sq * sq).eval(out=sq)
+        assert sq == sq2
+
+    def test_shape_mismatch(self):
+        a, b = self.mats["a"], self.mats["b"]
+        with self.assertRaises(IndexError):
+            a * a
+        with self.assertRaises(IndexError):
+            a + b
+
+
+class testStats(unittest.TestCase):
+
+    def test_stats(self):
+        _matrix.reset_stats()
+        mat = make_matrix(4, 4, lambda it, jt: it + jt)
+        _matrix.multiply_naive(mat, mat)
+        _matrix.multiply(mat, mat)
+        stats = _matrix.stats()
+        if not _matrix.instrumented:
+            assert stats == {}
+            return
+        assert stats["convert.setitem.calls"] == 16
+        assert stats["multiply_naive.calls"] == 1
+        assert stats["multiply.calls"] == 1
+        _matrix.reset_stats()
+        assert _matrix.stats()["multiply.calls"] == 0
+
+
+if __name__ == "__main__":
+    unittest.main()